@@ -10,31 +10,176 @@
 #include "BallPerceptor.h"
 #include "Tools/Debugging/DebugDrawings.h"
 #include "Tools/Math/Geometry.h"
+#include "Tools/Debugging/Debugging.h"
+#include "Tools/Debugging/Stopwatch.h"
+#include "MRL/Instrumentation.h"
 
-#include <iostream>
-#include <fstream> //-- For sake of taking snap shots
-#include <ctime> //-- For sake of taking snap shots
-#include <sstream> //-- For sake of taking snap shots
+#include <algorithm>
 
 // [FIXME] : move these
 #define minWhitePercentage (0.35)
 #define minNonGreenPercentage (0.7)
 #define minBlackPercentage (0.04)
 #define maxBlackPercentage (0.7)
+#define trackingIterations (FRHT_ITERATIONS/10) //-- Of the hough transform around the last ball
+#define trackingWindowScale (2.5)               //-- Half of the searched window, in radii of the predicted ball
+#define trackingMargin (8)                      //-- Added to the half window for the ball moving, pixels
+#define maxVerifiedCandidates (24)              //-- Of the parallel verification, bounds its time on busy frames
+#define anytimeHoughShare (0.5)                 //-- Of the budget left after the edge image, the rest is for the verification
+#define anytimeIterationsScale (8)              //-- Bounds the hough iterations of the anytime mode, times the fixed ones
+#define anytimeConfidentScore (2.6)             //-- Of scoreBall, which is at most 3, stops the verification of the anytime mode
+
+//-- Adds one of the filters below to a cascade, which times it
+#define STAGE(cascade, name, check) \
+  cascade.add(name, [this](float x, float y, float r) { return check; })
 
 
 MAKE_MODULE(BallPerceptor, Perception)
 
+BallPerceptor::CameraPipeline::CameraPipeline(const Image& image, unsigned baseIterations) :
+  edgeImage(image),
+  houghTransform(edgeImage),
+  baseIterations(baseIterations),
+  iterations(baseIterations),
+  budget(0),
+  usedTime(0)
+{
+}
+
 BallPerceptor::BallPerceptor() :
-  edgeImage(theImage),
-  houghTransform(edgeImage)
+  upperPipeline(theImage, FRHT_ITERATIONS),
+  lowerPipeline(theImage, FRHT_LOWER_ITERATIONS),
+  colorClasses(theImage, theColorReference),
+  colorIntegral(colorClasses),
+  verificationWorkers(verificationThreads ? new WorkerPool(verificationThreads) : 0),
+  workersRunning(false),
+  takeASnapShotFlag(false),
+  acceptedCandidates(0),
+  rejectedCandidates(0),
+  recording(recordEveryImage != 0),
+  images(0)
+{
+  for (CameraPipeline* pipeline : {&upperPipeline, &lowerPipeline})
+  {
+    addFilters(*pipeline);
+    pipeline->edgeImage.setThreads(edgeThreads);
+    pipeline->houghTransform.setThreads(houghThreads);
+    pipeline->iterations = pipeline->baseIterations * std::max(houghThreads, 1u);
+  }
+  upperPipeline.budget = upperTimeBudget;
+  lowerPipeline.budget = lowerTimeBudget;
+
+  //-- Here and not in update, so that the frame loop never opens files
+  if (!snapShotLog.empty())
+    snapShots.open(snapShotLog);
+  if (!recordingFile.empty())
+    recorder.open(recordingFile);
+}
+
+BallPerceptor::~BallPerceptor()
+{
+  delete verificationWorkers;
+}
+
+unsigned BallPerceptor::usedTime(CameraInfo::Camera camera) const
+{
+  return (camera == CameraInfo::upper ? upperPipeline : lowerPipeline).usedTime;
+}
+
+float BallPerceptor::usedBudget(CameraInfo::Camera camera) const
+{
+  const CameraPipeline& pipeline = camera == CameraInfo::upper ? upperPipeline : lowerPipeline;
+  return pipeline.budget ? (float)pipeline.usedTime / pipeline.budget : 0;
+}
+
+void BallPerceptor::addFilters(CameraPipeline& pipeline)
+{
+  FilterCascade& candidateFilters = pipeline.candidateFilters;
+  FilterCascade& refinedFilters = pipeline.refinedFilters;
+
+  //-- Size Filter
+  STAGE(candidateFilters, "size", r <= 60 && r >= 2.5);
+
+  //-- White Percentage
+  STAGE(candidateFilters, "whitePercentage", checkWhitePercentage(x, y, r));
+
+  //-- The order below is the initial guess, the cheap ones first. Afterwards the
+  //   cascade runs the filters rejecting the most per microsecond first.
+
+  //-- Again Checking size!
+  STAGE(refinedFilters, "refinedSize", r <= 60 && r >= 2.5);
+
+  STAGE(refinedFilters, "belowFieldBoundary", checkBelowFieldBoundary(x, y, r));
+
+  //-- Actual Size check
+  STAGE(refinedFilters, "projectedRadius", checkProjectedRadius(x, y, r));
+
+  STAGE(refinedFilters, "outOfBody", checkOutOfBody(x, y, r));
+
+  // [NOTE] : the process of checking radius and white percentage although it's heavy but it is done twice,
+  //          please note that the second one (this one down below) is done to check whether this object
+  //          has enough white pixel in it. But the first one is done to ignore refining edges for waste
+  //          object. So, however this is a heavy process, but it's reduces the time cost overly.
+  STAGE(refinedFilters, "refinedWhitePercentage", checkWhitePercentage(x, y, r));
+
+  //-- White / Black Percentage
+  STAGE(refinedFilters, "blackPercentage", checkBlackPercentage(x, y, r));
+}
+
+static void outputCounters()
 {
+  const Instrumentation& instrumentation = Instrumentation::get();
+  for (int i=0; i<instrumentation.channels(); ++i)
+  {
+    const Instrumentation::Channel& c = instrumentation.channel(i);
+    OUTPUT_TEXT(c.name.load() << ": " << c.lastFrameCalls << " calls, " << c.lastFrameValue << " counted");
+  }
+}
+
+static void outputCascade(const char* name, const FilterCascade& cascade)
+{
+  for (const FilterCascade::Stage& stage : cascade.stages())
+    OUTPUT_TEXT(name << " " << stage.name << ": " << stage.calls << " calls, "
+                << stage.rejections << " rejections, " << stage.time << " us");
 }
 
 void BallPerceptor::update(BallPercept& ballPercept)
 {
-  static bool takeASnapShotFlag = false;
-  DEBUG_RESPONSE("module:BallPerceptor:takeSnapShot", takeASnapShotFlag = true; );
+  //-- Calls and counted values of the frame before, edge points of the scan, found by the refines, circles
+  //-- fitted by findCircle and rejections of each filter
+  INSTRUMENT_FRAME();
+  DEBUG_RESPONSE("module:BallPerceptor:counters", outputCounters(); );
+  INSTRUMENT_SCOPE("ballPerceptor.update");
+
+  DEBUG_RESPONSE("module:BallPerceptor:record",
+  {
+    if (recorder.isOpen())
+    {
+      recording = !recording;
+      OUTPUT_TEXT("BallPerceptor: recording " << (recording ? "resumed" : "paused"));
+    }
+    else
+      OUTPUT_TEXT("BallPerceptor: no recording is open, set recordingFile in ballPerceptor.cfg");
+  });
+
+  //-- Only copied here, the recorder writes it on its own thread
+  if (recording && recorder.isOpen() && images++ % std::max(recordEveryImage, 1u) == 0)
+    recorder.record(theImage, theCameraInfo, theCameraMatrix, theImageCoordinateSystem, theFieldBoundary, theBodyContour, theColorReference);
+
+  DEBUG_RESPONSE("module:BallPerceptor:takeSnapShot",
+  {
+    if (snapShots.isOpen())
+      takeASnapShotFlag = true;
+    else
+      OUTPUT_TEXT("BallPerceptor: no snap shot log is open, set snapShotLog in ballPerceptor.cfg");
+  });
+  DEBUG_RESPONSE("module:BallPerceptor:filterCascade",
+  {
+    outputCascade("upper candidate", upperPipeline.candidateFilters);
+    outputCascade("upper refined", upperPipeline.refinedFilters);
+    outputCascade("lower candidate", lowerPipeline.candidateFilters);
+    outputCascade("lower refined", lowerPipeline.refinedFilters);
+  });
 
   DECLARE_DEBUG_DRAWING("module:BallPerceptor:edgePoints", "drawingOnImage");
   DECLARE_DEBUG_DRAWING("module:BallPerceptor:houghPoints", "drawingOnImage");
@@ -46,17 +191,77 @@ void BallPerceptor::update(BallPercept& ballPercept)
   ballPercept.ballWasSeen = false;
   ballPercept.status = BallPercept::notSeen;
 
-  edgeImage.isCameraUpper = theCameraInfo.camera == CameraInfo::upper;
-  edgeImage.originY = theImageCoordinateSystem.origin.y;
-  edgeImage.update();
-  houghTransform.update();
+  CameraPipeline& pipeline = theCameraInfo.camera == CameraInfo::upper ? upperPipeline : lowerPipeline;
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  pipeline.deadline = start + std::chrono::microseconds(pipeline.budget);
+
+  colorClasses.reset();
+  colorIntegral.reset();
+  pipeline.candidateFilters.newFrame();
+  pipeline.refinedFilters.newFrame();
+  pipeline.edgeImage.originY = theImageCoordinateSystem.origin.y;
+
+  //-- Searching around where the last ball should be now first, the whole image only if it is not there
+  Vector2<> predictedPosition;
+  float predictedRadius;
+  bool found = false;
+  if (pipeline.lastBall.valid && predictBall(pipeline.lastBall, predictedPosition, predictedRadius))
+  {
+    updateRegion(pipeline.edgeImage);
+    restrictRegion(pipeline.edgeImage, predictedPosition, predictedRadius);
+    pipeline.houghTransform.iterations = trackingIterations;
+    STOP_TIME_ON_REQUEST("module:BallPerceptor:tracking", found = searchBall(pipeline, ballPercept); );
+  }
+
+  if (!found)
+  {
+    updateRegion(pipeline.edgeImage);
+    pipeline.houghTransform.iterations = pipeline.iterations * (pipeline.budget ? anytimeIterationsScale : 1);
+    searchBall(pipeline, ballPercept);
+  }
 
-  for (const auto& p : edgeImage.edgePoints())
-    DOT("module:BallPerceptor:edgePoints", p.x, p.y, ColorClasses::red, ColorClasses::red);
+  pipeline.usedTime = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+  INSTRUMENT_COUNT("ballPerceptor.usedTime", pipeline.usedTime);
+}
+
+bool BallPerceptor::searchBall(CameraPipeline& pipeline, BallPercept& ballPercept)
+{
+  EdgeImage& edgeImage = pipeline.edgeImage;
+  FRHT& houghTransform = pipeline.houghTransform;
+  pipeline.lastBall.valid = false;
+
+  STOP_TIME_ON_REQUEST("module:BallPerceptor:edgeImage", edgeImage.update(); );
+
+  //-- The edges are searched anyway, the hough transform gets its share of what is left of the budget
+  houghTransform.anytime = pipeline.budget != 0;
+  if (houghTransform.anytime)
+  {
+    const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    houghTransform.deadline = now + std::chrono::duration_cast<std::chrono::steady_clock::duration>((pipeline.deadline - now) * anytimeHoughShare);
+  }
+  STOP_TIME_ON_REQUEST("module:BallPerceptor:frht", houghTransform.update(); );
+
+  COMPLEX_DRAWING("module:BallPerceptor:edgePoints",
+  {
+    for (const auto& p : edgeImage.edgePoints())
+      DOT("module:BallPerceptor:edgePoints", p.x, p.y, ColorClasses::red, ColorClasses::red);
+  });
 
   INIT_DEBUG_IMAGE(edgeImage,edgeImage);
   SEND_DEBUG_IMAGE(edgeImage);
 
+  if (pipeline.budget)
+  {
+    float x, y, r;
+    return verifyUntilDeadline(pipeline, x, y, r) >= 0 && acceptBall(pipeline, ballPercept, x, y, r);
+  }
+
+  if (verificationWorkers)
+  {
+    float x, y, r;
+    return verifyInParallel(pipeline, x, y, r) >= 0 && acceptBall(pipeline, ballPercept, x, y, r);
+  }
+
   //-- Checking the hough results:
   for (const auto& c : houghTransform.extractedCircles())
   {
@@ -64,63 +269,195 @@ void BallPerceptor::update(BallPercept& ballPercept)
     float y = c.y * edgeImage.avStep;
     float r = c.z * edgeImage.avStep;
 
-    //-- Size Filter
-    if (r > 60 || r < 2.5)
-      continue;
+    if (!verifyCandidate(pipeline, x, y, r))
+      sampleCandidate(x, y, r, false);
+    else if (acceptBall(pipeline, ballPercept, x, y, r))
+      return true;
+  }
+  return false;
+}
+
+bool BallPerceptor::verifyCandidate(CameraPipeline& pipeline, float& x, float& y, float& r)
+{
+  if (!pipeline.candidateFilters.run(x, y, r))
+    return false;
+
+  bool refined = false;
+  if (workersRunning)
+    refined = refineEdges(x, y, r);
+  else
+    STOP_TIME_ON_REQUEST("module:BallPerceptor:refineEdges", refined = refineEdges(x, y, r); );
+
+  return refined && pipeline.refinedFilters.run(x, y, r);
+}
+
+int BallPerceptor::verifyInParallel(CameraPipeline& pipeline, float& x, float& y, float& r)
+{
+  //-- Only the best voted ones, the hough transform puts them first
+  const std::vector<Vector3f>& circles = pipeline.houghTransform.extractedCircles();
+  const int avStep = pipeline.edgeImage.avStep;
+  const unsigned count = std::min<unsigned>(circles.size(), maxVerifiedCandidates);
+  verifications.resize(count);
+
+  workersRunning = true;
+  STOP_TIME_ON_REQUEST("module:BallPerceptor:verification",
+  {
+    verificationWorkers->run(count, [&](unsigned job, unsigned)
+    {
+      Verification& v = verifications[job];
+      v.verified = true;
+      v.x = circles[job].x * avStep;
+      v.y = circles[job].y * avStep;
+      v.r = circles[job].z * avStep;
+      v.passed = verifyCandidate(pipeline, v.x, v.y, v.r);
+      v.score = v.passed ? scoreBall(v.x, v.y, v.r) : 0;
+    });
+  });
+  workersRunning = false;
+
+  return takeBestVerification(count, x, y, r);
+}
+
+int BallPerceptor::verifyUntilDeadline(CameraPipeline& pipeline, float& x, float& y, float& r)
+{
+  //-- In the order of the votes, none started after the deadline or after a confident one, but the first
+  const std::vector<Vector3f>& circles = pipeline.houghTransform.extractedCircles();
+  const int avStep = pipeline.edgeImage.avStep;
+  const unsigned count = circles.size();
+  verifications.assign(count, Verification()); //-- The ones never started are neither verified nor passed
+  std::atomic<bool> confident(false);
+
+  const WorkerPool::Job verify = [&](unsigned job, unsigned)
+  {
+    Verification& v = verifications[job];
+    v.verified = v.passed = false;
+    if (confident.load(std::memory_order_relaxed) || (job && std::chrono::steady_clock::now() >= pipeline.deadline))
+      return;
+
+    v.verified = true;
+    v.x = circles[job].x * avStep;
+    v.y = circles[job].y * avStep;
+    v.r = circles[job].z * avStep;
+    v.passed = verifyCandidate(pipeline, v.x, v.y, v.r);
+    v.score = v.passed ? scoreBall(v.x, v.y, v.r) : 0;
+    if (v.score >= anytimeConfidentScore)
+      confident = true;
+  };
+
+  if (verificationWorkers)
+  {
+    workersRunning = true;
+    STOP_TIME_ON_REQUEST("module:BallPerceptor:verification", verificationWorkers->run(count, verify); );
+    workersRunning = false;
+  }
+  else
+    STOP_TIME_ON_REQUEST("module:BallPerceptor:verification",
+    {
+      for (unsigned i=0; i<count && !confident; ++i)
+        verify(i, 0);
+    });
 
-    //-- White Percentage
-    if (!checkWhitePercentage(x, y, r))
-      continue;
+  return takeBestVerification(count, x, y, r);
+}
 
-    if (!refineEdges(x, y, r))
-      continue;
+int BallPerceptor::takeBestVerification(unsigned count, float& x, float& y, float& r)
+{
+  //-- Ties go to the candidate with more votes, so the result does not depend on the threads
+  int best = -1;
+  for (unsigned i=0; i<count; ++i)
+    if (verifications[i].passed && (best < 0 || verifications[i].score > verifications[best].score))
+      best = i;
+    else if (verifications[i].verified && !verifications[i].passed)
+      sampleCandidate(verifications[i].x, verifications[i].y, verifications[i].r, false);
+
+  if (best >= 0)
+  {
+    x = verifications[best].x;
+    y = verifications[best].y;
+    r = verifications[best].r;
+  }
+  return best;
+}
 
-    //-- Again Checking size!
-    if (r > 60 || r < 2.5)
-      continue;
+bool BallPerceptor::acceptBall(CameraPipeline& pipeline, BallPercept& ballPercept, float x, float y, float r)
+{
+  CIRCLE("module:BallPerceptor:selectedHoughs", x,y,r,1, Drawings::bs_solid, ColorClasses::red, Drawings::bs_null, ColorClasses::red);
 
-    // [NOTE] : the process of checking radius and white percentage although it's heavy but it is done twice,
-    //          please note that the second one (this one down below) is done to check whether this object
-    //          has enough white pixel in it. But the first one is done to ignore refining edges for waste
-    //          object. So, however this is a heavy process, but it's reduces the time cost overly.
-    if (!checkWhitePercentage(x, y, r))
-      continue;
+  //-- Exporting results
+  if (!theCameraMatrix.isValid)
+    return false;
+
+  ballPercept.positionInImage = Vector2<>(x, y);
+  ballPercept.radiusInImage = r;
+  if (!calculateBallOnField(ballPercept))
+    return false;
 
-    //-- White / Black Percentage
-    if (!checkBlackPercentage(x, y, r))
-      continue;
+  ballPercept.status = BallPercept::seen;
+  ballPercept.ballWasSeen = true;
+  if (takeASnapShotFlag)
+  {
+    takeASnapShot(x, y, r, SnapShotLogger::accepted | SnapShotLogger::requested);
+    takeASnapShotFlag = false;
+  }
+  else
+    sampleCandidate(x, y, r, true);
 
-    if (!checkBelowFieldBoundary(x, y, r))
-     continue;
+  pipeline.lastBall.valid = true;
+  pipeline.lastBall.positionInImage = ballPercept.positionInImage;
+  pipeline.lastBall.radiusInImage = ballPercept.radiusInImage;
+  pipeline.lastBall.positionOnField = ballPercept.relativePositionOnField;
+  return true;
+}
 
-    //-- Actual Size check
-    if (!checkProjectedRadius(x, y, r))
-      continue;
+bool BallPerceptor::predictBall(const TrackedBall& ball, Vector2<>& positionInImage, float& radiusInImage)
+{
+  //-- The ball is assumed to lie still relative to the robot, so only the motion of the camera moves it in the image
+  if (!theCameraMatrix.isValid)
+    return false;
 
-    if (!checkOutOfBody(x, y, r))
-      continue;
+  const Vector3<> onField(ball.positionOnField.x, ball.positionOnField.y, (float) theFieldDimensions.ballRadius);
+  Vector2<> corrected;
+  if (!Geometry::calculatePointInImage(onField, theCameraMatrix, theCameraInfo, corrected))
+    return false;
 
-    CIRCLE("module:BallPerceptor:selectedHoughs", x,y,r,1, Drawings::bs_solid, ColorClasses::red, Drawings::bs_null, ColorClasses::red);
+  positionInImage = theImageCoordinateSystem.fromCorrected(corrected);
+  radiusInImage = theCameraInfo.focalLength * theFieldDimensions.ballRadius / (onField - theCameraMatrix.translation).abs();
+  return positionInImage.x + radiusInImage >= 0 && positionInImage.x - radiusInImage < theImage.width &&
+         positionInImage.y + radiusInImage >= 0 && positionInImage.y - radiusInImage < theImage.height;
+}
 
-    //-- Exporting results
-    if (theCameraMatrix.isValid)
+void BallPerceptor::restrictRegion(EdgeImage& edgeImage, const Vector2<>& center, float radius)
+{
+  const float halfWindow = radius * trackingWindowScale + trackingMargin;
+  const int left = std::max(0, (int)((center.x - halfWindow) / edgeImage.avStep));
+  const int right = std::min((int) edgeImage.regionTop.size(), (int)((center.x + halfWindow) / edgeImage.avStep) + 1);
+  const int top = (int)std::floor((center.y - halfWindow) / edgeImage.avStep);
+  const int bottom = (int)((center.y + halfWindow) / edgeImage.avStep) + 1;
+
+  for (int x=0; x<(int)edgeImage.regionTop.size(); ++x)
+    if (x < left || x >= right)
+      edgeImage.regionBottom[x] = edgeImage.regionTop[x];
+    else
     {
-      ballPercept.positionInImage = Vector2<>(x, y);
-      ballPercept.radiusInImage = r;
-      Geometry::Circle c;
-      if(calculateBallOnField(ballPercept))
-      {
-        ballPercept.status = BallPercept::seen;
-        ballPercept.ballWasSeen = true;
-        if (takeASnapShotFlag)
-        {
-          takeASnapShot(x,y,r);
-          takeASnapShotFlag = false;
-        }
-
-        return;
-      }
+      edgeImage.regionTop[x] = std::max(edgeImage.regionTop[x], top);
+      edgeImage.regionBottom[x] = std::min(edgeImage.regionBottom[x], bottom);
     }
+}
+
+void BallPerceptor::updateRegion(EdgeImage& edgeImage)
+{
+  //-- Edges are only searched where a ball can pass checkBelowFieldBoundary and checkOutOfBody
+  const int width = theImage.width / edgeImage.avStep;
+  edgeImage.regionTop.resize(width);
+  edgeImage.regionBottom.resize(width);
+  for (int x=0; x<width; ++x)
+  {
+    const int imageX = x * edgeImage.avStep;
+    int bottom = theImage.height - 1;
+    theBodyContour.clipBottom(imageX, bottom);
+
+    edgeImage.regionTop[x] = (theFieldBoundary.getBoundaryY(imageX) + 1) / edgeImage.avStep;
+    edgeImage.regionBottom[x] = bottom / edgeImage.avStep + 1;
   }
 }
 
@@ -155,24 +492,33 @@ bool BallPerceptor::checkProjectedRadius(int cx, int cy, int r)
   bool isProjected = Geometry::calculatePointOnField(Vector2<>(cx-r, cy), BALL_WIDTH_2, theCameraMatrix, theCameraInfo, projectedLeft) &&
       Geometry::calculatePointOnField(Vector2<>(cx+r, cy), BALL_WIDTH_2, theCameraMatrix, theCameraInfo, projectedRight);
 
-  return (abs(abs(projectedLeft.y - projectedRight.y) - BALL_WIDTH) < 50);
+  return isProjected && (abs(abs(projectedLeft.y - projectedRight.y) - BALL_WIDTH) < 50);
 }
 
-bool BallPerceptor::checkWhitePercentage(int cx, int cy, int r)
+float BallPerceptor::scoreBall(int cx, int cy, int r)
 {
-  int whitePixel=0, nonGreenPixels = 0, totalSearchedPixel=0;
-  for (int sx=0; sx<r; ++sx)
-  {
-    const int& sY = sqrt(r*r - sx*sx); //-- calculating maximum sy in the mentioned sx
-    for (int sy=0; sy<sY; ++sy)
-    {
-      totalSearchedPixel += searchedColor(cx+sx, cy+sy, whitePixel, nonGreenPixels);
-      totalSearchedPixel += searchedColor(cx-sx, cy+sy, whitePixel, nonGreenPixels);
+  //-- Whiter, less green and closer to the size of a ball is better, each part is at most one
+  int counts[ColorIntegral::numOfCounters] = {0};
+  const int totalSearchedPixel = countInDisc(cx, cy, r, counts);
+  if (totalSearchedPixel == 0)
+    return 0;
 
-      totalSearchedPixel += searchedColor(cx+sx, cy-sy, whitePixel, nonGreenPixels);
-      totalSearchedPixel += searchedColor(cx-sx, cy-sy, whitePixel, nonGreenPixels);
-    }
-  }
+  float score = (float)counts[ColorIntegral::white]/(float)totalSearchedPixel +
+                (float)counts[ColorIntegral::nonGreen]/(float)totalSearchedPixel;
+
+  Vector3<> projectedLeft,projectedRight;
+  if (Geometry::calculatePointOnField(Vector2<>(cx-r, cy), BALL_WIDTH_2, theCameraMatrix, theCameraInfo, projectedLeft) &&
+      Geometry::calculatePointOnField(Vector2<>(cx+r, cy), BALL_WIDTH_2, theCameraMatrix, theCameraInfo, projectedRight))
+    score += 1 - std::min(1.f, std::abs(std::abs(projectedLeft.y - projectedRight.y) - BALL_WIDTH) / (float)BALL_WIDTH);
+  return score;
+}
+
+bool BallPerceptor::checkWhitePercentage(int cx, int cy, int r)
+{
+  int counts[ColorIntegral::numOfCounters] = {0};
+  const int totalSearchedPixel = countInDisc(cx, cy, r, counts);
+  const int whitePixel = counts[ColorIntegral::white];
+  const int nonGreenPixels = counts[ColorIntegral::nonGreen];
 
   if (totalSearchedPixel == 0)
     return false;
@@ -184,15 +530,27 @@ bool BallPerceptor::checkWhitePercentage(int cx, int cy, int r)
   return true;
 }
 
-int BallPerceptor::searchedColor(int x, int y, int& color, int& nonGreen)
+int BallPerceptor::countInDisc(int cx, int cy, int r, int counts[ColorIntegral::numOfCounters])
 {
-  if (x > -1 && x < theImage.width && y > -1 && y < theImage.height)
+  //-- The disc used to be visited pixel by pixel as (cx+-sx, cy+-sy) for sx < r and sy < sqrt(r*r - sx*sx).
+  //   So in the rows cy+-sy there are `w' columns on each side, where w is the number of sx reaching that
+  //   row. As sx = 0 and sy = 0 were visited twice, the center column and the center row are counted twice.
+  int totalSearchedPixel = 0;
+  int w = r;
+  for (int sy=0; sy<r; ++sy)
   {
-    nonGreen += theColorReference.isGreen(theImage[y]+x)?0:1;
-    color += theColorReference.isWhite(theImage[y]+x);
-    return 1;
+    while (w > 0 && (int)sqrt(r*r - (w-1)*(w-1)) <= sy)
+      --w;
+    if (!w)
+      break;
+
+    totalSearchedPixel += colorIntegral.count(cy+sy, cx-w+1, cx+w-1, counts);
+    totalSearchedPixel += colorIntegral.count(cy+sy, cx, cx, counts);
+
+    totalSearchedPixel += colorIntegral.count(cy-sy, cx-w+1, cx+w-1, counts);
+    totalSearchedPixel += colorIntegral.count(cy-sy, cx, cx, counts);
   }
-  return 0;
+  return totalSearchedPixel;
 }
 
 #define SEARCH_STEP(limit, startRadius, countingFormula, condtion, exportFunction, debug) \
@@ -209,19 +567,26 @@ int BallPerceptor::searchedColor(int x, int y, int& color, int& nonGreen)
       } \
       p += step; \
       exportFunction; \
-      debug; \
+      if (!workersRunning) \
+      { \
+        debug; \
+      } \
     } \
   }
 
 bool BallPerceptor::refineEdges(float& X, float& Y, float& R)
 {
+  //-- The searches below start from the center, so it has to be inside the image
+  if (X < 0 || X >= theImage.width || Y < 0 || Y >= theImage.height)
+    return false;
+
   Vector2i topLeft;
   Vector2i bottomRight;
 
-  SEARCH_STEP(theImage.width - X, R, X+(p+step), theColorReference.isGreen(theImage[Y]+c),      bottomRight.x = c, LINE("module:BallPerceptor:searchLine", X, Y, c, Y, 1, Drawings::bs_solid, ColorClasses::green););
-  SEARCH_STEP(                 X, R, X-(p+step), theColorReference.isGreen(theImage[Y]+c),      topLeft.x = c,     LINE("module:BallPerceptor:searchLine", X, Y, c, Y, 1, Drawings::bs_solid, ColorClasses::green););
-  SEARCH_STEP(theImage.height- Y, R, Y+(p+step), theColorReference.isGreen(theImage[c]+(int)X), bottomRight.y = c, LINE("module:BallPerceptor:searchLine", X, Y, X, c, 1, Drawings::bs_solid, ColorClasses::green););
-  SEARCH_STEP(                 Y, R, Y-(p+step), theColorReference.isGreen(theImage[c]+(int)X), topLeft.y = c,     LINE("module:BallPerceptor:searchLine", X, Y, X, c, 1, Drawings::bs_solid, ColorClasses::green););
+  SEARCH_STEP(theImage.width - X, R, X+(p+step), c >= theImage.width  || colorClasses.isGreen(c, Y), bottomRight.x = c, LINE("module:BallPerceptor:searchLine", X, Y, c, Y, 1, Drawings::bs_solid, ColorClasses::green););
+  SEARCH_STEP(                 X, R, X-(p+step), c < 0                || colorClasses.isGreen(c, Y), topLeft.x = c,     LINE("module:BallPerceptor:searchLine", X, Y, c, Y, 1, Drawings::bs_solid, ColorClasses::green););
+  SEARCH_STEP(theImage.height- Y, R, Y+(p+step), c >= theImage.height || colorClasses.isGreen(X, c), bottomRight.y = c, LINE("module:BallPerceptor:searchLine", X, Y, X, c, 1, Drawings::bs_solid, ColorClasses::green););
+  SEARCH_STEP(                 Y, R, Y-(p+step), c < 0                || colorClasses.isGreen(X, c), topLeft.y = c,     LINE("module:BallPerceptor:searchLine", X, Y, X, c, 1, Drawings::bs_solid, ColorClasses::green););
 
   X = (topLeft.x + bottomRight.x) / 2;
   Y = (topLeft.y + bottomRight.y) / 2;
@@ -232,19 +597,9 @@ bool BallPerceptor::refineEdges(float& X, float& Y, float& R)
 
 bool BallPerceptor::checkBlackPercentage(int cx, int cy, int r)
 {
-  int blackPixels = 0, totalSearchedPixel=0;
-  for (int sx=0; sx<r; ++sx)
-  {
-    const int& sY = sqrt(r*r - sx*sx); //-- calculating maximum sy in the mentioned sx
-    for (int sy=0; sy<sY; ++sy)
-    {
-      totalSearchedPixel += searchedColorForBlack(cx+sx, cy+sy, blackPixels);
-      totalSearchedPixel += searchedColorForBlack(cx-sx, cy+sy, blackPixels);
-
-      totalSearchedPixel += searchedColorForBlack(cx+sx, cy-sy, blackPixels);
-      totalSearchedPixel += searchedColorForBlack(cx-sx, cy-sy, blackPixels);
-    }
-  }
+  int counts[ColorIntegral::numOfCounters] = {0};
+  const int totalSearchedPixel = countInDisc(cx, cy, r, counts);
+  const int blackPixels = counts[ColorIntegral::black];
 
   if (totalSearchedPixel == 0)
     return false;
@@ -255,21 +610,6 @@ bool BallPerceptor::checkBlackPercentage(int cx, int cy, int r)
   return true;
 }
 
-int BallPerceptor::searchedColorForBlack(int x, int y, int& black)
-{
-  if (x > -1 && x < theImage.width && y > -1 && y < theImage.height)
-  {
-    black += isBlack(theImage[y]+x, theColorReference);
-    return 1;
-  }
-  return 0;
-}
-
-bool BallPerceptor::isBlack(const Image::Pixel* p, const ColorReference& r)
-{
-	return r.isOrange(p) && !r.isGreen(p) && !r.isBlue(p);
-}
-
 bool BallPerceptor::calculateBallOnField(BallPercept& ballPercept)
 {
   const Vector2<> correctedCenter = theImageCoordinateSystem.toCorrected(ballPercept.positionInImage);
@@ -295,66 +635,22 @@ bool BallPerceptor::calculateBallOnField(BallPercept& ballPercept)
   return true;
 }
 
-void BallPerceptor::takeASnapShot(int cx, int cy, int r)
+void BallPerceptor::sampleCandidate(float x, float y, float r, bool accepted)
 {
-  static int nameCFO = 0;
-  std::stringstream fileNameImage;
-  std::stringstream fileNameMeta;
-  fileNameImage << "/home/mrlspl/logs/SnapShot_" << time(0) << "_" << nameCFO << ".image";
-  fileNameMeta  << "/home/mrlspl/logs/SnapShot_" << time(0) << "_" << nameCFO << ".meta";
-
-  std::ofstream outFileImage(fileNameImage.str(), std::ios::out | std::ios::binary | std::ios::trunc);
-  std::ofstream outFileMeta(fileNameMeta.str(),   std::ios::out | std::ios::trunc);
-  if (!outFileImage)
-  {
-    std::cerr << "Can not create output file image...\n";
-    return;
-  }
-  if (!outFileMeta)
-  {
-    std::cerr << "Can not create output file meta-data...\n";
-    return;
-  }
-
-#define BUFFER_WIDTH 30
-#define BUFFER_SIZE (BUFFER_WIDTH*BUFFER_WIDTH*3)
+  unsigned& candidates = accepted ? acceptedCandidates : rejectedCandidates;
+  const unsigned every = accepted ? snapShotEveryAccepted : snapShotEveryRejected;
+  if (every && ++candidates % every == 0)
+    takeASnapShot(x, y, r, accepted ? SnapShotLogger::accepted : 0);
+}
 
-  unsigned char dataBuffer[BUFFER_SIZE];
-  for (unsigned j=0; j<BUFFER_WIDTH; ++j)
-    for (unsigned i=0; i<BUFFER_WIDTH; ++i)
-    {
-      const int x = (2*r*i/BUFFER_WIDTH + cx - r);
-      const int y = (2*r*j/BUFFER_WIDTH + cy - r);
-
-      if (x > -1 && x < theImage.width && y > -1 && y < theImage.height)
-      {
-        dataBuffer[j*BUFFER_WIDTH*3+i*3+0] = theImage[y][x].y;
-        dataBuffer[j*BUFFER_WIDTH*3+i*3+1] = theImage[y][x].cb;
-        dataBuffer[j*BUFFER_WIDTH*3+i*3+2] = theImage[y][x].cr;
-      }
-      else
-      {
-        dataBuffer[j*BUFFER_WIDTH*3+i*3+0] = 0;
-        dataBuffer[j*BUFFER_WIDTH*3+i*3+1] = 0;
-        dataBuffer[j*BUFFER_WIDTH*3+i*3+2] = 0;
-      }
-    }
+bool BallPerceptor::takeASnapShot(int cx, int cy, int r, unsigned flags)
+{
+  //-- Only copied to the ring of the logger here, its own thread writes the file. Without the log
+  //-- of snapShotLog there is nothing to do, the frame loop must not open files.
+  if (!snapShots.isOpen())
+    return false;
 
-  outFileImage.write((const char*)dataBuffer, BUFFER_SIZE);
-  outFileImage.close();
-
-  outFileMeta << BUFFER_SIZE << " # Buffer Size\n"
-              << BUFFER_WIDTH << " # Buffer Width\n"
-              << BUFFER_WIDTH << " # Buffer Height\n"
-              << cx << " # Ball X\n"
-              << cy << " # Ball Y\n"
-              << r << " # Ball Radius\n"
-              << theImageCoordinateSystem.origin.y << " # Horizon Y \n"
-              << theImage.width << " # Frame Width\n"
-              << theImage.height << " # Frame Height\n";
-  outFileMeta.close();
-
-  if (nameCFO++ > 9876)
-    nameCFO = 0;
+  if (theCameraInfo.camera == CameraInfo::lower)
+    flags |= SnapShotLogger::lowerCamera;
+  return snapShots.log(theImage, cx, cy, r, theImageCoordinateSystem.origin.y, flags);
 }
-
@@ -8,6 +8,8 @@
 
 #pragma once
 
+#include <chrono>
+#include <string>
 #include <vector>
 
 #include "Tools/Module/Module.h"
@@ -23,6 +25,12 @@
 
 #include "MRL/EdgeImage.h"
 #include "MRL/FRHT.h"
+#include "MRL/ColorClassCache.h"
+#include "MRL/ColorIntegral.h"
+#include "MRL/FilterCascade.h"
+#include "MRL/WorkerPool.h"
+#include "MRL/SnapShotLogger.h"
+#include "MRL/FrameRecorder.h"
 
 class Image;
 
@@ -37,28 +45,138 @@ MODULE(BallPerceptor)
   REQUIRES(BodyContour)
   REQUIRES(FilteredJointData)
   PROVIDES_WITH_MODIFY_AND_OUTPUT_AND_DRAW(BallPercept)
+
+  //-- The parameters are read from ballPerceptor.cfg when the module is created
+
+  //-- Without threads the first candidate passing all the filters is taken. With them, the best voted
+  //-- candidates are all verified at once by that many workers and the one with the best score is taken.
+  LOADS_PARAMETER(unsigned, verificationThreads)
+
+  //-- Threads searching the edges of the images of each camera
+  LOADS_PARAMETER(unsigned, edgeThreads)
+
+  //-- Runs the iterations of the hough transforms concurrently on that many threads, with that many
+  //-- times the iterations of the whole image search. Without threads they run one after another.
+  LOADS_PARAMETER(unsigned, houghThreads)
+
+  //-- Anytime mode, with a budget in microseconds for each image of a camera, 0 for the fixed iterations.
+  //-- The hough transform then iterates until its share of the budget is spent and the candidates are
+  //-- verified until all of it is, or until one is confident enough. The best scored one is taken.
+  LOADS_PARAMETER(unsigned, upperTimeBudget)
+  LOADS_PARAMETER(unsigned, lowerTimeBudget)
+
+  //-- Log the snap shots are appended to, opened when the module is created, empty for none. Of every that
+  //-- many accepted and rejected candidates one is logged, 0 for none of them. The debug response
+  //-- takeSnapShot logs the next accepted one anyway, but only to this log.
+  LOADS_PARAMETER(std::string, snapShotLog)
+  LOADS_PARAMETER(unsigned, snapShotEveryAccepted)
+  LOADS_PARAMETER(unsigned, snapShotEveryRejected)
+
+  //-- Recording of the images with all the representations used for them, for replaying them offline. It is
+  //-- created when the module is created, empty for none. While recording, one of every that many images is
+  //-- written. With 0 it starts paused, the debug response record pauses and resumes it.
+  LOADS_PARAMETER(std::string, recordingFile)
+  LOADS_PARAMETER(unsigned, recordEveryImage)
 END_MODULE
 
 class BallPerceptor: public BallPerceptorBase
 {
 public:
   BallPerceptor();
+  ~BallPerceptor();
+
+  //-- Microseconds the last image of the camera took, and the part of its budget that is
+  unsigned usedTime(CameraInfo::Camera camera) const;
+  float usedBudget(CameraInfo::Camera camera) const;
+
+  //-- Closing it writes the snap shots still waiting
+  SnapShotLogger& snapShotLogger() { return snapShots; }
+
+  //-- Closing it writes the frames still waiting and the index
+  FrameRecorder& frameRecorder() { return recorder; }
 
 private:
   void update(BallPercept& ballPercept);
   bool checkWhitePercentage(int cx, int cy, int r);
-  int searchedColor(int x, int y, int& color, int& nonGreen);
+  int countInDisc(int cx, int cy, int r, int counts[ColorIntegral::numOfCounters]);
   bool refineEdges(float& x, float& y, float& r);
   bool isNotGreenChecked(int x, int y);
   bool checkBlackPercentage(int cx, int cy, int r);
-  int searchedColorForBlack(int x, int y, int& black);
-  bool isBlack(const Image::Pixel* p, const ColorReference& r);
   bool checkBelowFieldBoundary(int x, int y, int r);
   bool checkProjectedRadius(int x, int y, int r);
   bool calculateBallOnField(BallPercept& ballPercept);
   bool checkOutOfBody(int x, int y, int r);
-  void takeASnapShot(int x, int y, int r);
+  bool takeASnapShot(int x, int y, int r, unsigned flags);
+  void sampleCandidate(float x, float y, float r, bool accepted);
+  void updateRegion(EdgeImage& edgeImage);
+
+  //-- The last ball verified in the images of one camera
+  class TrackedBall
+  {
+  public:
+    TrackedBall() : valid(false), radiusInImage(0) {}
+
+    bool valid;
+    Vector2<> positionInImage;
+    float radiusInImage;
+    Vector2<> positionOnField;
+  };
+
+  //-- Everything kept from one frame to the next, once for each camera
+  class CameraPipeline
+  {
+  public:
+    CameraPipeline(const Image& image, unsigned baseIterations);
+
+    EdgeImage edgeImage;
+    FRHT houghTransform;
+    FilterCascade candidateFilters; //-- Checks on the circles of the hough transform, before refining them
+    FilterCascade refinedFilters;   //-- Checks on the refined circles
+    unsigned baseIterations;        //-- Of the hough transform searching the whole image with one thread
+    unsigned iterations;            //-- Of the hough transform searching the whole image
+    TrackedBall lastBall;
+
+    unsigned budget;                                //-- us per image in the anytime mode, 0 without it
+    unsigned usedTime;                              //-- us of the last image
+    std::chrono::steady_clock::time_point deadline; //-- Of the running image
+  };
+
+  void addFilters(CameraPipeline& pipeline);
+  bool predictBall(const TrackedBall& ball, Vector2<>& positionInImage, float& radiusInImage);
+  void restrictRegion(EdgeImage& edgeImage, const Vector2<>& center, float radius);
+  bool searchBall(CameraPipeline& pipeline, BallPercept& ballPercept);
+  int verifyUntilDeadline(CameraPipeline& pipeline, float& x, float& y, float& r);
+  bool verifyCandidate(CameraPipeline& pipeline, float& x, float& y, float& r);
+  int verifyInParallel(CameraPipeline& pipeline, float& x, float& y, float& r);
+  int takeBestVerification(unsigned count, float& x, float& y, float& r);
+  float scoreBall(int cx, int cy, int r);
+  bool acceptBall(CameraPipeline& pipeline, BallPercept& ballPercept, float x, float y, float r);
+
+  //-- Result of verifying one candidate in the parallel mode
+  class Verification
+  {
+  public:
+    bool verified; //-- Not in the anytime mode after the deadline
+    bool passed;
+    float x, y, r;
+    float score;
+  };
+
+  CameraPipeline upperPipeline;
+  CameraPipeline lowerPipeline;
+  DECLARE_DEBUG_IMAGE(edgeImage);
+  ColorClassCache colorClasses; //-- Only about the current frame, shared by both cameras
+  ColorIntegral colorIntegral;
+
+  WorkerPool* verificationWorkers;         //-- Only in the parallel mode
+  std::vector<Verification> verifications; //-- One per candidate
+  bool workersRunning;                     //-- The filters must not use stopwatches and drawings then, they are not thread safe
+  bool takeASnapShotFlag;
+
+  SnapShotLogger snapShots;
+  unsigned acceptedCandidates, rejectedCandidates; //-- Counted for the sampling
 
-  EdgeImage edgeImage; DECLARE_DEBUG_IMAGE(edgeImage);
-  FRHT houghTransform;
+  FrameRecorder recorder;
+  bool recording;  //-- Not paused
+  unsigned images; //-- Counted for the recording
 };
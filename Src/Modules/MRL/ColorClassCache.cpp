@@ -0,0 +1,80 @@
+/**
+ * @file ColorClassCache.cpp
+ * Color classes of the current image as one bit mask per pixel
+ * @author <a href="mailto:agent@local">agent</a>
+ * @date Oct 2026
+ */
+
+#include "ColorClassCache.h"
+
+ColorClassCache::ColorClassCache(const Image& image, const ColorReference& colorReference) :
+  _image(image),
+  _colorReference(colorReference),
+  _width(0),
+  _height(0),
+  _tilesX(0),
+  _tilesY(0),
+  _frame(0)
+{
+}
+
+ColorClassCache::~ColorClassCache()
+{
+}
+
+void ColorClassCache::reset()
+{
+  _colorTable.update(_colorReference);
+
+  if (_width != _image.width || _height != _image.height)
+  {
+    _width = _image.width;
+    _height = _image.height;
+    _tilesX = (_width + tileWidth - 1) / tileWidth;
+    _tilesY = (_height + tileHeight - 1) / tileHeight;
+    _tileFrame.reset(new std::atomic<unsigned>[_tilesX * _tilesY]);
+    for (int tile=0; tile<_tilesX * _tilesY; ++tile)
+      _tileFrame[tile].store(0, std::memory_order_relaxed);
+    _classes.resize(_width * _height);
+  }
+
+  //-- Instead of clearing, tiles of older frames are classified again when they are asked for
+  if (++_frame == 0)
+  {
+    for (int tile=0; tile<_tilesX * _tilesY; ++tile)
+      _tileFrame[tile].store(0, std::memory_order_relaxed);
+    _frame = 1;
+  }
+}
+
+const unsigned char* ColorClassCache::row(int y, int x1, int x2)
+{
+  const int tileRow = (y / tileHeight) * _tilesX;
+  for (int tile=tileRow + x1 / tileWidth; tile<=tileRow + x2 / tileWidth; ++tile)
+    if (_tileFrame[tile].load(std::memory_order_acquire) != _frame)
+      classifyTile(tile);
+  return &_classes[y * _width];
+}
+
+void ColorClassCache::classifyTile(int tile)
+{
+  //-- Another thread may have classified it since it was asked for
+  std::lock_guard<std::mutex> lock(_classifyMutex);
+  if (_tileFrame[tile].load(std::memory_order_relaxed) == _frame)
+    return;
+
+  const int startX = (tile % _tilesX) * tileWidth;
+  const int startY = (tile / _tilesX) * tileHeight;
+  const int endX = startX + tileWidth < _width ? startX + tileWidth : _width;
+  const int endY = startY + tileHeight < _height ? startY + tileHeight : _height;
+
+  for (int y=startY; y<endY; ++y)
+  {
+    const Image::Pixel* src = _image[y];
+    unsigned char* dst = &_classes[y * _width];
+    for (int x=startX; x<endX; ++x)
+      dst[x] = _colorTable.classify(src + x);
+  }
+
+  _tileFrame[tile].store(_frame, std::memory_order_release);
+}
@@ -0,0 +1,72 @@
+/**
+ * @file ColorClassCache.h
+ * Color classes of the current image as one bit mask per pixel. The image is
+ * classified in tiles, the first time a pixel of a tile is asked for in a
+ * frame, so each pixel is looked up at most once. Several threads may ask for
+ * pixels at once, between two resets.
+ * @author <a href="mailto:agent@local">agent</a>
+ * @date Oct 2026
+ */
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "Representations/Infrastructure/Image.h"
+#include "Representations/Perception/ColorReference.h"
+#include "ColorClassTable.h"
+
+class ColorClassCache
+{
+public:
+  enum ColorBit
+  {
+    green  = ColorClassTable::green,
+    white  = ColorClassTable::white,
+    orange = ColorClassTable::orange,
+    blue   = ColorClassTable::blue
+  };
+
+  ColorClassCache(const Image& image, const ColorReference& colorReference);
+  ~ColorClassCache();
+
+  //-- Forgets all the classes, has to be called for every new image
+  //   (and lets the lookup table follow the color reference)
+  void reset();
+
+  inline int width() const { return _width; }
+  inline int height() const { return _height; }
+
+  //-- Color bits of the pixel (x, y), which has to be inside the image
+  inline unsigned char get(int x, int y)
+  {
+    const int tile = (y / tileHeight) * _tilesX + x / tileWidth;
+    if (_tileFrame[tile].load(std::memory_order_acquire) != _frame)
+      classifyTile(tile);
+    return _classes[y * _width + x];
+  }
+
+  //-- Row y with at least the pixels x1..x2 (inclusive) classified
+  const unsigned char* row(int y, int x1, int x2);
+
+  inline bool isGreen(int x, int y) { return get(x, y) & green; }
+  inline bool isWhite(int x, int y) { return get(x, y) & white; }
+  inline bool isBlack(int x, int y) { return (get(x, y) & (orange | green | blue)) == orange; }
+
+private:
+  //-- Tiles of one row fit the spans of ColorIntegral and the single pixels of the edge searches
+  enum { tileWidth = 32, tileHeight = 1 };
+
+  const Image& _image;
+  const ColorReference& _colorReference;
+  ColorClassTable _colorTable;
+  int _width, _height, _tilesX, _tilesY;
+  unsigned _frame;
+  std::unique_ptr<std::atomic<unsigned>[]> _tileFrame; //-- Frame in which each tile has been classified
+  std::vector<unsigned char> _classes;
+  std::mutex _classifyMutex; //-- Only taken for classifying, tiles are read without it once their frame is set
+
+  void classifyTile(int tile);
+};
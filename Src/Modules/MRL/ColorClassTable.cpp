@@ -0,0 +1,85 @@
+/**
+ * @file ColorClassTable.cpp
+ * Lookup table from YCbCr to the color bits of the color reference
+ * @author <a href="mailto:agent@local">agent</a>
+ * @date Oct 2026
+ */
+
+#include "ColorClassTable.h"
+
+ColorClassTable::ColorClassTable() :
+  _colorReference(0),
+  _table(0),
+  _next(0),
+  _built(false),
+  _building(false),
+  _dirty(true)
+{
+  _tables[0].resize(size);
+  _tables[1].resize(size);
+}
+
+ColorClassTable::~ColorClassTable()
+{
+  if (_builder.joinable())
+    _builder.join();
+}
+
+void ColorClassTable::update(const ColorReference& colorReference)
+{
+  _colorReference = &colorReference;
+
+  //-- A stale table would not match the color reference anymore
+  if (colorReference.changed)
+  {
+    _dirty = true;
+    _table = 0;
+  }
+
+  if (_building && _built)
+  {
+    _builder.join();
+    _building = false;
+    if (!_dirty) //-- Otherwise it has been built for an older color reference
+    {
+      _table = &_tables[_next][0];
+      _next ^= 1;
+    }
+  }
+
+  if (_dirty && !_building)
+  {
+    _buildReference = colorReference;
+    _dirty = false;
+    _built = false;
+    _building = true;
+    _builder = std::thread(&ColorClassTable::build, this);
+  }
+}
+
+void ColorClassTable::build()
+{
+  unsigned char* table = &_tables[_next][0];
+  Image::Pixel p;
+  p.color = 0;
+
+  for (int y=0; y<64; ++y)
+    for (int cb=0; cb<64; ++cb)
+      for (int cr=0; cr<64; ++cr)
+      {
+        //-- All the colors of the cell have to agree
+        unsigned char all = 0xff, any = 0;
+        for (int i=0; i<4*4*4; ++i)
+        {
+          p.y = (y << 2) | (i >> 4);
+          p.cb = (cb << 2) | ((i >> 2) & 3);
+          p.cr = (cr << 2) | (i & 3);
+          const unsigned char c = classify(_buildReference, &p);
+          all &= c;
+          any |= c;
+        }
+        table[(y << 12) | (cb << 6) | cr] = all == any ? all : ambiguous;
+      }
+
+  _built = true;
+}
@@ -0,0 +1,75 @@
+/**
+ * @file ColorClassTable.h
+ * Lookup table from YCbCr to the color bits of the color reference, with
+ * 6 bits per channel. The table is rebuilt in a background thread whenever
+ * the color reference changes. Cells whose 4x4x4 colors are not all of the
+ * same classes are marked as ambiguous and answered by the color reference
+ * itself, so the table always gives the same result as the color reference.
+ * @author <a href="mailto:agent@local">agent</a>
+ * @date Oct 2026
+ */
+
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "Representations/Infrastructure/Image.h"
+#include "Representations/Perception/ColorReference.h"
+
+class ColorClassTable
+{
+public:
+  enum ColorBit
+  {
+    green     = 1,
+    white     = 2,
+    orange    = 4, //-- Black is labelled as orange in the color reference
+    blue      = 8,
+    ambiguous = 128
+  };
+
+  ColorClassTable();
+  ~ColorClassTable();
+
+  //-- Has to be called for every frame, starts a rebuild if the color reference changed
+  void update(const ColorReference& colorReference);
+
+  //-- True if lookups are answered by the table, otherwise all go to the color reference
+  bool isReady() const { return _table != 0; }
+
+  inline unsigned char classify(const Image::Pixel* p) const
+  {
+    if (_table)
+    {
+      const unsigned char c = _table[((p->y >> 2) << 12) | ((p->cb >> 2) << 6) | (p->cr >> 2)];
+      if (!(c & ambiguous))
+        return c;
+    }
+    return classify(*_colorReference, p);
+  }
+
+  static inline unsigned char classify(const ColorReference& colorReference, const Image::Pixel* p)
+  {
+    return (colorReference.isGreen(p) ? green : 0) |
+           (colorReference.isWhite(p) ? white : 0) |
+           (colorReference.isOrange(p) ? orange : 0) |
+           (colorReference.isBlue(p) ? blue : 0);
+  }
+
+private:
+  enum { size = 64 * 64 * 64 };
+
+  const ColorReference* _colorReference;
+  const unsigned char* _table; //-- The table in use, 0 while there is none for the current color reference
+  std::vector<unsigned char> _tables[2];
+  int _next; //-- The table the builder writes
+
+  std::thread _builder;
+  std::atomic<bool> _built;
+  bool _building;
+  bool _dirty;
+  ColorReference _buildReference; //-- Copy for the builder, the blackboard one may change meanwhile
+
+  void build();
+};
@@ -0,0 +1,81 @@
+/**
+ * @file ColorIntegral.cpp
+ * Row-wise prefix counts of white, non-green and black pixels
+ * @author <a href="mailto:agent@local">agent</a>
+ * @date Oct 2026
+ */
+
+#include "ColorIntegral.h"
+
+ColorIntegral::ColorIntegral(ColorClassCache& colorClasses) :
+  _colorClasses(colorClasses),
+  _width(0),
+  _height(0)
+{
+}
+
+ColorIntegral::~ColorIntegral()
+{
+}
+
+void ColorIntegral::reset()
+{
+  if (_width != _colorClasses.width() || _height != _colorClasses.height())
+  {
+    _width = _colorClasses.width();
+    _height = _colorClasses.height();
+    _rowEnd.reset(new std::atomic<int>[_height]);
+    _counts.resize(_height * _width);
+  }
+
+  //-- Instead of clearing, rows are rebuilt from their beginning when they are asked for
+  for (int y=0; y<_height; ++y)
+    _rowEnd[y].store(0, std::memory_order_relaxed);
+}
+
+int ColorIntegral::count(int y, int x1, int x2, int counts[numOfCounters])
+{
+  if (y < 0 || y >= _height)
+    return 0;
+  if (x1 < 0)
+    x1 = 0;
+  if (x2 >= _width)
+    x2 = _width - 1;
+  if (x1 > x2)
+    return 0;
+
+  if (_rowEnd[y].load(std::memory_order_acquire) <= x2)
+    buildRow(y, x2 + 1);
+
+  const Counts* row = &_counts[y * _width];
+  for (int i=0; i<numOfCounters; ++i)
+    counts[i] += row[x2].c[i] - (x1 > 0 ? row[x1-1].c[i] : 0);
+
+  return x2 - x1 + 1;
+}
+
+void ColorIntegral::buildRow(int y, int end)
+{
+  //-- Another thread may have built it further since it was asked for
+  std::lock_guard<std::mutex> lock(_buildMutex);
+  const int start = _rowEnd[y].load(std::memory_order_relaxed);
+  if (start >= end)
+    return;
+  end = start + chunkWidth > end ? start + chunkWidth : end;
+  if (end > _width)
+    end = _width;
+
+  const unsigned char* classes = _colorClasses.row(y, start, end-1);
+  Counts* row = &_counts[y * _width];
+  Counts sum = start ? row[start-1] : Counts();
+  for (int x=start; x<end; ++x)
+  {
+    const unsigned char c = classes[x];
+    sum.c[white] += (c & ColorClassCache::white) != 0;
+    sum.c[nonGreen] += !(c & ColorClassCache::green);
+    sum.c[black] += (c & (ColorClassCache::orange | ColorClassCache::green | ColorClassCache::blue)) == ColorClassCache::orange;
+    row[x] = sum;
+  }
+
+  _rowEnd[y].store(end, std::memory_order_release);
+}
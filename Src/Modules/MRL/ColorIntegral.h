@@ -0,0 +1,57 @@
+/**
+ * @file ColorIntegral.h
+ * Row-wise prefix counts of white, non-green and black pixels, so that the
+ * number of such pixels in a span of a row costs a subtraction. The counts
+ * run from the beginning of the row and are built lazily from the color class
+ * cache, a row only up to the rightmost pixel asked for in the frame. Several
+ * threads may count at once, between two resets.
+ * @author <a href="mailto:agent@local">agent</a>
+ * @date Oct 2026
+ */
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "ColorClassCache.h"
+
+class ColorIntegral
+{
+public:
+  enum Counter
+  {
+    white,
+    nonGreen,
+    black, //-- Black is labelled as orange in the color reference
+    numOfCounters
+  };
+
+  ColorIntegral(ColorClassCache& colorClasses);
+  ~ColorIntegral();
+
+  //-- Forgets all the counts, has to be called for every new image after resetting the cache
+  void reset();
+
+  //-- Adds the counts of the pixels x1..x2 (inclusive) of row y to `counts'
+  //   and returns the number of those pixels inside the image.
+  int count(int y, int x1, int x2, int counts[numOfCounters]);
+
+private:
+  enum { chunkWidth = 32 }; //-- Rows are extended by at least that many pixels at once
+
+  class Counts
+  {
+  public:
+    unsigned short c[numOfCounters]; //-- Counts from the beginning of the row up to this pixel
+  };
+
+  ColorClassCache& _colorClasses;
+  int _width, _height;
+  std::unique_ptr<std::atomic<int>[]> _rowEnd; //-- Pixels of each row built in this frame
+  std::vector<Counts> _counts;
+  std::mutex _buildMutex; //-- Only taken for building, counts are read without it below the end of their row
+
+  void buildRow(int y, int end);
+};
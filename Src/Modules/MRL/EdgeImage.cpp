@@ -6,130 +6,416 @@
  */
 
 #include "EdgeImage.h"
+#include "Instrumentation.h"
+#include <algorithm>
 #include <iostream>
 #include <cmath>
 #include "Tools/Debugging/DebugDrawings.h"
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #define pl //std::cout << __FILE__ << " :: " << __LINE__ << "\n";
 
 // [FIXME] : make this a class scope function
 //-- Filtered Pixel!
+//-- `pxl' is the pixel of the edge image, `pxlOrg' the one of the camera image
 #define __fixel(__x, __y, __action) \
- if (__x < this->width && __x > -1 && __y < this->height && __y > -1) { Image::Pixel& pxl = (*this)[__y][__x]; const Image::Pixel& pxlOrg = _image[__y][__x];  __action; }
+ if (__x < this->width && __x > -1 && __y < this->height && __y > -1) { Image::Pixel& pxl = (*this)[__y][__x];  __action; }
 #define fixel(__x, __y, __action) __fixel(__x, __y, __action)
+#define orgFixel(__x, __y, __action) \
+ if (__x < this->width && __x > -1 && __y < this->height && __y > -1) { const Image::Pixel& pxlOrg = _image[__y][__x];  __action; }
 //#define fixel(__x, __y, __action) __fixel(__x/avStep, (originY+__y)/avStep, __action)
-#define SC_X(row, col) (_scanGraphLookup.at(row).at(col).x/avStep)
-#define SC_Y(row, col) ((_scanGraphLookup.at(row).at(col).y+originY)/avStep)
+
+#define EDGE_BANDS_PER_WORKER 4 //-- More bands than workers, so that one slow band does not hold up the others
+
+// [TODO] : make this threshold a configurable parameter.
+#define EDGE_THRESHOLD 60
+//-- The magnitude used to be compared as (int)sqrt(sum) > 60, which is the same as sum > 61*61-1
+#define EDGE_THRESHOLD_SQR ((EDGE_THRESHOLD+1)*(EDGE_THRESHOLD+1)-1)
 
 Image::Pixel EdgeImage::black;
 Image::Pixel EdgeImage::red;
+Image::Pixel EdgeImage::edge;
+Image::Pixel EdgeImage::processed;
 
 
 EdgeImage::EdgeImage(const Image& image) :
-  isCameraUpper(false),
   originY(0),
+  avStep(1),
   _image(image),
-  avStep(1)
+  _scanGraph(-1),
+  _scannedGraph(-1),
+  _refinedBegin(maxResolutionHeight, maxResolutionWidth),
+  _refinedEnd(maxResolutionHeight, 0),
+  _scratch(1),
+  _workers(0),
+  _updateThreads(1),
+  _refineThreads(1)
 {
   black.cr = black.cb = 127; black.y = 0;
   red.cr = 250; red.cb = 0; red.y = 127;
+  edge.cr = edge.cb = 127; edge.y = 255;
+  processed.cr = processed.cb = 127; processed.y = 1;
 }
 
 EdgeImage::~EdgeImage()
 {
+  delete _workers;
+}
+
+void EdgeImage::setThreads(unsigned threads)
+{
+  delete _workers;
+  _workers = threads > 1 ? new WorkerPool(threads) : 0;
+  _updateThreads = _workers ? _workers->size() : 1;
+  _scratch.resize(std::max(_updateThreads, _refineThreads));
+}
+
+void EdgeImage::setRefineThreads(unsigned threads)
+{
+  _refineThreads = std::max(threads, 1u);
+  _scratch.resize(std::max(_updateThreads, _refineThreads));
 }
 
 void EdgeImage::createLookup()
 {
+  for (_scanGraph=0; _scanGraph<(int)_scanGraphs.size(); ++_scanGraph)
+  {
+    const ScanGraph& graph = _scanGraphs[_scanGraph];
+    if (graph.imageWidth == _image.width && graph.imageHeight == _image.height && graph.avStep == avStep)
+    {
+      setResolution(_image.width/avStep, _image.height/avStep);
+      return;
+    }
+  }
+
   std::cout << "creating edge lookup table...\n";
   setResolution(_image.width/avStep, _image.height/avStep);
 
+  //-- Every pixel except the ones written by later frames stays black from here on
+  for (int y=0; y<height; ++y)
+    for (int x=0; x<width; ++x)
+      (*this)[y][x] = black; //_image[y*avStep][x*avStep];
+
+  _scanGraphs.push_back(ScanGraph());
+  ScanGraph& graph = _scanGraphs.back();
+  graph.imageWidth = _image.width;
+  graph.imageHeight = _image.height;
+  graph.avStep = avStep;
+
+  //-- Rows go down to twice the height, as originY can move them up
   for (int y=0; y< height*2; y+=edgeingStep(y))
   {
-    std::vector<Vector2i> scanRow;
+    graph.rowY.push_back(y+10);
+    graph.rowStart.push_back(graph.columns.size());
+
+    const int start = graph.columns.size();
+    graph.columns.push_back(-1);
     for (int x=0; x< width; x+=edgeingStep(y))
-      scanRow.push_back(Vector2i(x, y+10));
-    _scanGraphLookup.push_back(scanRow);
+      graph.columns.push_back(x/avStep);
+    graph.columns.push_back(graph.columns.back()+1);
+    graph.columns[start] = graph.columns[start+1]-1;
+
+    const int count = graph.columns.size() - start - 2;
+    int first = 0, last = count;
+    while (first < last && graph.columns[start+first] < 0)
+      ++first;
+    while (last > first && graph.columns[start+last+1] >= width)
+      --last;
+    graph.first.push_back(first);
+    graph.last.push_back(last);
   }
-
-  static int i=0;
-  if (i++ > 10)
-    std::cerr << "[It looks this message is keep popping out!]\n[it might be because the difference of the upper and lower camera resolution.]\n\n";
+  graph.rowStart.push_back(graph.columns.size());
 }
 
-void EdgeImage::refine(const Vector2i& point)
+bool EdgeImage::refineWindow(const Vector2i& point, int& startX, int& startY, int& endX, int& endY) const
 {
   // [FIXME] : I'm not sure about the step, revise the way of step calculation
   const int step = edgeingStep(point.y-originY);// + edgeingStep(point.y));
 
-  const int startX = (point.x-step)>1 ? (point.x-step) : 1;
-  const int startY = (point.y-step)>1 ? (point.y-step) : 1;
+  startX = (point.x-step)>1 ? (point.x-step) : 1;
+  startY = (point.y-step)>1 ? (point.y-step) : 1;
 
-  const int endX = (point.x+step)<(width-1)  ? (point.x+step) : (width-1);
-  const int endY = (point.y+step)<(height-1) ? (point.y+step) : (height-1);
+  endX = (point.x+step)<(width-1)  ? (point.x+step) : (width-1);
+  endY = (point.y+step)<(height-1) ? (point.y+step) : (height-1);
 
+  //-- The window is inside the image with a margin of one pixel, so whole rows can be calculated at once
+  return endX > startX;
+}
+
+void EdgeImage::refine(const Vector2i& point)
+{
+  INSTRUMENT_SCOPE("edgeImage.refine");
+  const int edgePointsBefore = _edgePoints.size();
+  const bool masked = hasRegion();
+
+  int startX, startY, endX, endY;
+  if (!refineWindow(point, startX, startY, endX, endY))
+    return;
+
+  const int count = endX - startX;
+  Scratch& scratch = _scratch[0];
+  scratch.columns.resize(count + 2);
+  scratch.isEdge.resize(count);
+  for (int i=0; i<count+2; ++i)
+    scratch.columns[i] = startX - 1 + i;
 
   for (int y=startY; y<endY; ++y)
+  {
+    _refinedBegin[y] = std::min(_refinedBegin[y], startX);
+    _refinedEnd[y] = std::max(_refinedEnd[y], endX);
+    calculateEdges(&scratch.columns[0], count, y-1, y, y+1, &scratch.isEdge[0], scratch.planes);
+
+    Pixel* row = (*this)[y];
     for (int x=startX; x<endX; ++x)
     {
       if (x == point.x && y == point.y)
         continue;
+      if (masked && !inRegion(x, y))
+        continue;
 
-      Vector2i middle = Vector2i(x,y);
+      //-- Only unprocessed pixels, the others stay as they are
+      Pixel& pxl = row[x];
+      if (pxl.y != 0)
+        continue;
+
+      if (scratch.isEdge[x-startX])
+      {
+        pxl = red;
+        _edgePoints.push_back(Vector2i(x, y));
+      }
+    }
+  }
+  INSTRUMENT_COUNT("edgeImage.refine", _edgePoints.size() - edgePointsBefore);
+}
+
+void EdgeImage::refine(const Vector2i& point, unsigned worker, std::vector<Vector2i>& found)
+{
+  INSTRUMENT_SCOPE("edgeImage.refine");
+  const int foundBefore = found.size();
+  const bool masked = hasRegion();
+
+  int startX, startY, endX, endY;
+  if (!refineWindow(point, startX, startY, endX, endY))
+    return;
+
+  const int count = endX - startX;
+  Scratch& scratch = _scratch[worker];
+  scratch.refinedWindows.push_back(Scratch::Window{startX, startY, endX, endY});
+  scratch.columns.resize(count + 2);
+  scratch.isEdge.resize(count);
+  for (int i=0; i<count+2; ++i)
+    scratch.columns[i] = startX - 1 + i;
 
-      bool validPixel = false;
-      fixel(middle.x,middle.y, validPixel = pxl.y == 0 );
-      if (!validPixel)
+  for (int y=startY; y<endY; ++y)
+  {
+    calculateEdges(&scratch.columns[0], count, y-1, y, y+1, &scratch.isEdge[0], scratch.planes);
+
+    Pixel* row = (*this)[y];
+    for (int x=startX; x<endX; ++x)
+    {
+      if (x == point.x && y == point.y)
+        continue;
+      if ((masked && !inRegion(x, y)) || !scratch.isEdge[x-startX])
         continue;
 
-      Vector2i topLeft = Vector2i(x-1, y-1);
-      Vector2i bottomRight = Vector2i(x+1, y+1);
+      //-- Unprocessed or refined by someone else, only the scan results stay as they are. Every
+      //-- call marks the same pixels red, whichever comes first.
+      const unsigned char s = state(x, y);
+      if (s != black.y && s != red.y)
+        continue;
 
-      Pixel edgePixel = black;
-      fixel(middle.x, middle.y, edgePixel = calculateEdge(topLeft, middle, bottomRight); pxl = (edgePixel.y>127)?red:black; );
+      unsigned expected = black.color;
+      __atomic_compare_exchange_n(&row[x].color, &expected, red.color, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+      found.push_back(Vector2i(x, y));
     }
+  }
+  INSTRUMENT_COUNT("edgeImage.refine", found.size() - foundBefore);
 }
 
 void EdgeImage::update()
 {
-  // [TODO] : Implement field boundary
   // [FIXME] : do something about image boundaries that become edges
 pl
+  INSTRUMENT_SCOPE("edgeImage.update");
   _edgePoints.clear();
 
-  if (width != _image.width/avStep || height != _image.height/avStep)
+  //-- Before the resolution changes, the pixels written are where the last scan graph put them
+  clearWritten();
+
+  if (_scanGraph < 0 || width != _image.width/avStep || height != _image.height/avStep ||
+      _scanGraphs[_scanGraph].avStep != avStep)
     createLookup();
 
-  for (int y=0; y<height; ++y)
+  const ScanGraph& graph = _scanGraphs[_scanGraph];
+  const int rows = graph.rowY.size();
+  _scannedGraph = _scanGraph;
+
+  //-- Rows of the region, or of the whole image
+  const bool masked = hasRegion();
+  int regionMinY = 0, regionMaxY = height;
+  if (masked)
+  {
+    regionMinY = height;
+    regionMaxY = 0;
     for (int x=0; x<width; ++x)
-      (*this)[y][x] = black; //_image[y*avStep][x*avStep];
+      if (regionTop[x] < regionBottom[x])
+      {
+        regionMinY = std::min(regionMinY, std::max(regionTop[x], 0));
+        regionMaxY = std::max(regionMaxY, std::min(regionBottom[x], height));
+      }
+  }
+
+  //-- Rows are sorted by y, only the ones inside the image are scanned
+  int firstRow = 0, lastRow = rows;
+  while (firstRow < lastRow && graph.y(firstRow, originY) < regionMinY)
+    ++firstRow;
+  while (lastRow > firstRow && graph.y(lastRow-1, originY) >= regionMaxY)
+    --lastRow;
+
+  //-- Bands of about the same number of rows. Two rows on the same line, which avStep can make, stay in one band
+  const int bands = _workers ? std::max(1, std::min(lastRow - firstRow, (int)(_workers->size() * EDGE_BANDS_PER_WORKER))) : 1;
+  _bands.resize(bands);
+  for (int b=0; b<bands; ++b)
+  {
+    Band& band = _bands[b];
+    band.firstRow = b ? _bands[b-1].lastRow : firstRow;
+    band.lastRow = std::max(band.firstRow, firstRow + (lastRow - firstRow) * (b+1) / bands);
+    while (band.lastRow > band.firstRow && band.lastRow < lastRow &&
+           graph.y(band.lastRow, originY) == graph.y(band.lastRow-1, originY))
+      ++band.lastRow;
+  }
+
+  if (_workers)
+    _workers->run(bands, [this, masked](unsigned band, unsigned worker) { scanBand(_bands[band], _scratch[worker], masked); });
+  else
+    scanBand(_bands[0], _scratch[0], masked);
+
+  for (const Band& band : _bands)
+  {
+    _edgePoints.insert(_edgePoints.end(), band.edgePoints.begin(), band.edgePoints.end());
+    _scannedRows.insert(_scannedRows.end(), band.scannedRows.begin(), band.scannedRows.end());
+  }
+  INSTRUMENT_COUNT("edgeImage.update", _edgePoints.size());
 
-  for (unsigned row=0; row<_scanGraphLookup.size(); ++row)
-    for (unsigned col=0; col<_scanGraphLookup.at(row).size(); ++col)
+pl
+}
+
+void EdgeImage::scanBand(Band& band, Scratch& scratch, bool masked)
+{
+  const ScanGraph& graph = _scanGraphs[_scanGraph];
+  const int rows = graph.rowY.size();
+  band.edgePoints.clear();
+  band.scannedRows.clear();
+
+  for (int row=band.firstRow; row<band.lastRow; ++row)
+  {
+    const int count = graph.count(row);
+    if (!count)
+      continue;
+
+    //-- All the samples of a row are on the same line
+    const int middle = graph.y(row, originY);
+    const int top = (row>0)?graph.y(row-1, originY):middle-1;
+    const int bottom = (row<rows-1)?graph.y(row+1, originY):middle+1;
+
+    //-- Columns of the samples, with the left neighbour of the first one and the right neighbour of the last one
+    const int* columns = &graph.columns[graph.rowStart[row]];
+
+    //-- Samples in [begin, end) from the first to the last one inside the region
+    int begin = 0, end = count;
+    if (masked)
+    {
+      while (begin < end && !inRegion(columns[begin+1], middle))
+        ++begin;
+      while (end > begin && !inRegion(columns[end], middle))
+        --end;
+      if (begin == end)
+        continue;
+    }
+    band.scannedRows.push_back(Vector2i(row, middle));
+
+    //-- Samples in [first, last) have their whole neighbourhood inside the image
+    int first = begin, last = begin;
+    if (top > -1 && top < height && bottom > -1 && bottom < height)
     {
-      Vector2i middle = Vector2i(
-          SC_X(row, col),
-          SC_Y(row, col)
-          );
+      first = std::max(graph.first[row], begin);
+      last = std::max(std::min(graph.last[row], end), first);
+    }
 
-      Vector2i topLeft = Vector2i(
-          (col>0)?SC_X(row,col-1):SC_X(row,col)-1,
-          (row>0)?SC_Y(row-1,0):SC_Y(row,col)-1
-          );
+    scratch.isEdge.resize(count);
+    if (last > first)
+      calculateEdges(columns + first, last-first, top, middle, bottom, &scratch.isEdge[0], scratch.planes);
 
-      Vector2i bottomRight = Vector2i(
-          (col<_scanGraphLookup.at(row).size()-1)?SC_X(row,col+1):SC_X(row,col)+1,
-          (row<_scanGraphLookup.size()-1)?SC_Y(row+1,0):SC_Y(row,col)+1
-          );
+    Pixel* scanRow = (*this)[middle];
+    for (int col=begin; col<end; ++col)
+    {
+      const int x = columns[col+1];
+      if (masked && !inRegion(x, middle))
+        continue;
+
+      if (col >= first && col < last)
+      {
+        if (scratch.isEdge[col-first])
+        {
+          scanRow[x] = edge;
+          band.edgePoints.push_back(Vector2i(x, middle));
+        }
+        else
+          scanRow[x] = processed;
+        continue;
+      }
+
+      //-- Image borders, one pixel at a time
+      Vector2i topLeft = Vector2i(columns[col], top);
+      Vector2i center = Vector2i(x, middle);
+      Vector2i bottomRight = Vector2i(columns[col+2], bottom);
 
       Pixel edgePixel = black;
-      fixel(middle.x, middle.y, edgePixel = calculateEdge(topLeft, middle, bottomRight); pxl = edgePixel );
+      fixel(center.x, center.y, edgePixel = calculateEdge(topLeft, center, bottomRight, band.edgePoints); pxl = edgePixel );
     }
+  }
 
-pl
 }
 
-const Image::Pixel& EdgeImage::calculateEdge(const Vector2i& topLeft, const Vector2i& middle, const Vector2i& bottomRight)
+void EdgeImage::clearWritten()
+{
+  //-- Everything else is still black from the frames before
+  for (const Vector2i& scanned : _scannedRows)
+  {
+    const ScanGraph& graph = _scanGraphs[_scannedGraph];
+    const int* columns = &graph.columns[graph.rowStart[scanned.x]];
+    Pixel* row = (*this)[scanned.y];
+    for (int col=1; col<=graph.count(scanned.x); ++col)
+      row[columns[col]] = black;
+  }
+  _scannedRows.clear();
+
+  for (Scratch& scratch : _scratch)
+  {
+    for (const Scratch::Window& w : scratch.refinedWindows)
+      for (int y=w.startY; y<w.endY; ++y)
+      {
+        _refinedBegin[y] = std::min(_refinedBegin[y], w.startX);
+        _refinedEnd[y] = std::max(_refinedEnd[y], w.endX);
+      }
+    scratch.refinedWindows.clear();
+  }
+
+  for (int y=0; y<maxResolutionHeight; ++y)
+    if (_refinedBegin[y] < _refinedEnd[y])
+    {
+      std::fill((*this)[y] + _refinedBegin[y], (*this)[y] + _refinedEnd[y], black);
+      _refinedBegin[y] = maxResolutionWidth;
+      _refinedEnd[y] = 0;
+    }
+}
+
+Image::Pixel EdgeImage::calculateEdge(const Vector2i& topLeft, const Vector2i& middle, const Vector2i& bottomRight, std::vector<Vector2i>& edgePoints)
 {
   //-- Implementation of Sobel Filter
   //   This is Vertical Sobel Filter Parameters:
@@ -138,17 +424,20 @@ const Image::Pixel& EdgeImage::calculateEdge(const Vector2i& topLeft, const Vect
   //   [ +1  +2  +1 ]
   //   And it is the same for horizontal except with a counter clockwise flip
 
-  Pixel a0; fixel(topLeft.x,     topLeft.y, a0 = pxlOrg );
-  Pixel a1; fixel(middle.x,      topLeft.y, a1 = pxlOrg );
-  Pixel a2; fixel(bottomRight.x, topLeft.y, a2 = pxlOrg );
+  //-- Neighbours outside the image take the value of the middle, which is always inside
+  const Pixel& m = _image[middle.y][middle.x];
+
+  Pixel a0 = m; orgFixel(topLeft.x,     topLeft.y, a0 = pxlOrg );
+  Pixel a1 = m; orgFixel(middle.x,      topLeft.y, a1 = pxlOrg );
+  Pixel a2 = m; orgFixel(bottomRight.x, topLeft.y, a2 = pxlOrg );
 
-  Pixel a3; fixel(topLeft.x,     middle.y, a3 = pxlOrg );
-  Pixel a4; fixel(middle.x,      middle.y, a4 = pxlOrg );
-  Pixel a5; fixel(bottomRight.x, middle.y, a5 = pxlOrg );
+  Pixel a3 = m; orgFixel(topLeft.x,     middle.y, a3 = pxlOrg );
+  Pixel a4 = m; orgFixel(middle.x,      middle.y, a4 = pxlOrg );
+  Pixel a5 = m; orgFixel(bottomRight.x, middle.y, a5 = pxlOrg );
 
-  Pixel a6; fixel(topLeft.x,     bottomRight.y, a6 = pxlOrg );
-  Pixel a7; fixel(middle.x,      bottomRight.y, a7 = pxlOrg );
-  Pixel a8; fixel(bottomRight.x, bottomRight.y, a8 = pxlOrg );
+  Pixel a6 = m; orgFixel(topLeft.x,     bottomRight.y, a6 = pxlOrg );
+  Pixel a7 = m; orgFixel(middle.x,      bottomRight.y, a7 = pxlOrg );
+  Pixel a8 = m; orgFixel(bottomRight.x, bottomRight.y, a8 = pxlOrg );
 
 
   const int sobelVerticalY  = ((-a0.y  - 2*a1.y  - a2.y)  /* + 0*a3.y  + 0*a4.y  + 0*a5.y  */ + (a6.y  + 2*a7.y  + a8.y))  / 4;
@@ -159,21 +448,159 @@ const Image::Pixel& EdgeImage::calculateEdge(const Vector2i& topLeft, const Vect
   const int sobelHorizontalCb = ((-a0.cb - 2*a3.cb - a6.cb) /* + 0*a1.cb + 0*a4.cb + 0*a7.cb */ + (a2.cb + 2*a5.cb + a8.cb)) / 4;
   const int sobelHorizontalCr = ((-a0.cr - 2*a3.cr - a6.cr) /* + 0*a1.cr + 0*a4.cr + 0*a7.cr */ + (a2.cr + 2*a5.cr + a8.cr)) / 4;
 
-  Pixel result;
-  result.cb = result.cr = 127; result.y = 1;
-  const int ans = sqrt(
+  const int ans =
       sobelVerticalY*sobelVerticalY + sobelVerticalCb*sobelVerticalCb + sobelVerticalCr*sobelVerticalCr +
-      sobelHorizontalY*sobelHorizontalY + sobelHorizontalCb*sobelHorizontalCb + sobelHorizontalCr*sobelHorizontalCr);
+      sobelHorizontalY*sobelHorizontalY + sobelHorizontalCb*sobelHorizontalCb + sobelHorizontalCr*sobelHorizontalCr;
 
   //-- Thresholding:
-  if (ans > 60) // [TODO] : make this threshold a configurable parameter.
+  if (ans > EDGE_THRESHOLD_SQR)
+  {
+    edgePoints.push_back(middle);
+    return edge;
+  }
+
+  //-- result.y is 1 which means that this pixel has been processed
+  return processed;
+}
+
+//-- Truncating division by 4 of signed values, the same as `/ 4' in calculateEdge
+#define DIV4_EPI16(v, three) _mm_srai_epi16(_mm_add_epi16(v, _mm_and_si128(_mm_srai_epi16(v, 15), three)), 2)
+#define DIV4_EPI16_256(v, three) _mm256_srai_epi16(_mm256_add_epi16(v, _mm256_and_si256(_mm256_srai_epi16(v, 15), three)), 2)
+
+void EdgeImage::calculateEdges(const int* columns, int count, int top, int middle, int bottom, unsigned char* isEdge, std::vector<short>& planes)
+{
+  //-- The same Sobel filter as calculateEdge, for `count' samples of one row at once. Sample i is at
+  //   columns[i+1], its left and right neighbours are at columns[i] and columns[i+2]. All of them and
+  //   the rows top / bottom have to be inside the image.
+  //
+  //   The three rows are first copied into planes of 16 bit values, one per row and channel, so that
+  //   neighbouring samples are next to each other even if the scan graph skips pixels.
+  const int n = count + 2;
+  planes.resize(9 * n);
+
+  const int rows[3] = {top, middle, bottom};
+  for (int r=0; r<3; ++r)
+  {
+    const Pixel* src = _image[rows[r]];
+    short* y  = &planes[(r*3 + 0) * n];
+    short* cb = &planes[(r*3 + 1) * n];
+    short* cr = &planes[(r*3 + 2) * n];
+    for (int i=0; i<n; ++i)
+    {
+      const Pixel& p = src[columns[i]];
+      y[i] = p.y;
+      cb[i] = p.cb;
+      cr[i] = p.cr;
+    }
+  }
+
+  int i = 0;
+
+#if defined(__AVX2__)
+  const __m256i three256 = _mm256_set1_epi16(3);
+  const __m256i threshold256 = _mm256_set1_epi32(EDGE_THRESHOLD_SQR);
+  for (; i+16<=count; i+=16)
   {
-    result.y = 255;
-    _edgePoints.push_back(middle);
+    __m256i sumLow = _mm256_setzero_si256();
+    __m256i sumHigh = _mm256_setzero_si256();
+    for (int c=0; c<3; ++c)
+    {
+      const short* t = &planes[(0*3 + c) * n + i];
+      const short* m = &planes[(1*3 + c) * n + i];
+      const short* b = &planes[(2*3 + c) * n + i];
+
+      const __m256i t0 = _mm256_loadu_si256((const __m256i*)(t));
+      const __m256i t1 = _mm256_loadu_si256((const __m256i*)(t + 1));
+      const __m256i t2 = _mm256_loadu_si256((const __m256i*)(t + 2));
+      const __m256i m0 = _mm256_loadu_si256((const __m256i*)(m));
+      const __m256i m2 = _mm256_loadu_si256((const __m256i*)(m + 2));
+      const __m256i b0 = _mm256_loadu_si256((const __m256i*)(b));
+      const __m256i b1 = _mm256_loadu_si256((const __m256i*)(b + 1));
+      const __m256i b2 = _mm256_loadu_si256((const __m256i*)(b + 2));
+
+      const __m256i upper = _mm256_add_epi16(_mm256_add_epi16(t0, t2), _mm256_add_epi16(t1, t1));
+      const __m256i lower = _mm256_add_epi16(_mm256_add_epi16(b0, b2), _mm256_add_epi16(b1, b1));
+      const __m256i left  = _mm256_add_epi16(_mm256_add_epi16(t0, b0), _mm256_add_epi16(m0, m0));
+      const __m256i right = _mm256_add_epi16(_mm256_add_epi16(t2, b2), _mm256_add_epi16(m2, m2));
+
+      const __m256i vertical = DIV4_EPI16_256(_mm256_sub_epi16(lower, upper), three256);
+      const __m256i horizontal = DIV4_EPI16_256(_mm256_sub_epi16(right, left), three256);
+
+      //-- Interleaving both responses, so that madd gives v*v + h*h of each sample in 32 bits
+      const __m256i low = _mm256_unpacklo_epi16(vertical, horizontal);
+      const __m256i high = _mm256_unpackhi_epi16(vertical, horizontal);
+      sumLow = _mm256_add_epi32(sumLow, _mm256_madd_epi16(low, low));
+      sumHigh = _mm256_add_epi32(sumHigh, _mm256_madd_epi16(high, high));
+    }
+
+    //-- Packing undoes the interleaving, so the samples are back in order
+    const __m256i mask = _mm256_packs_epi32(_mm256_cmpgt_epi32(sumLow, threshold256), _mm256_cmpgt_epi32(sumHigh, threshold256));
+    const __m256i bytes = _mm256_permute4x64_epi64(_mm256_packs_epi16(mask, mask), 0x08);
+    _mm_storeu_si128((__m128i*)(isEdge + i), _mm256_castsi256_si128(bytes));
   }
-  //-- else: result.y remain 1 which means that this pixel has been processed
+#endif
+
+#if defined(__SSE2__)
+  const __m128i three = _mm_set1_epi16(3);
+  const __m128i threshold = _mm_set1_epi32(EDGE_THRESHOLD_SQR);
+  for (; i+8<=count; i+=8)
+  {
+    __m128i sumLow = _mm_setzero_si128();
+    __m128i sumHigh = _mm_setzero_si128();
+    for (int c=0; c<3; ++c)
+    {
+      const short* t = &planes[(0*3 + c) * n + i];
+      const short* m = &planes[(1*3 + c) * n + i];
+      const short* b = &planes[(2*3 + c) * n + i];
+
+      const __m128i t0 = _mm_loadu_si128((const __m128i*)(t));
+      const __m128i t1 = _mm_loadu_si128((const __m128i*)(t + 1));
+      const __m128i t2 = _mm_loadu_si128((const __m128i*)(t + 2));
+      const __m128i m0 = _mm_loadu_si128((const __m128i*)(m));
+      const __m128i m2 = _mm_loadu_si128((const __m128i*)(m + 2));
+      const __m128i b0 = _mm_loadu_si128((const __m128i*)(b));
+      const __m128i b1 = _mm_loadu_si128((const __m128i*)(b + 1));
+      const __m128i b2 = _mm_loadu_si128((const __m128i*)(b + 2));
+
+      const __m128i upper = _mm_add_epi16(_mm_add_epi16(t0, t2), _mm_add_epi16(t1, t1));
+      const __m128i lower = _mm_add_epi16(_mm_add_epi16(b0, b2), _mm_add_epi16(b1, b1));
+      const __m128i left  = _mm_add_epi16(_mm_add_epi16(t0, b0), _mm_add_epi16(m0, m0));
+      const __m128i right = _mm_add_epi16(_mm_add_epi16(t2, b2), _mm_add_epi16(m2, m2));
+
+      const __m128i vertical = DIV4_EPI16(_mm_sub_epi16(lower, upper), three);
+      const __m128i horizontal = DIV4_EPI16(_mm_sub_epi16(right, left), three);
+
+      //-- Interleaving both responses, so that madd gives v*v + h*h of each sample in 32 bits
+      const __m128i low = _mm_unpacklo_epi16(vertical, horizontal);
+      const __m128i high = _mm_unpackhi_epi16(vertical, horizontal);
+      sumLow = _mm_add_epi32(sumLow, _mm_madd_epi16(low, low));
+      sumHigh = _mm_add_epi32(sumHigh, _mm_madd_epi16(high, high));
+    }
 
-  return result;
+    const __m128i mask = _mm_packs_epi32(_mm_cmpgt_epi32(sumLow, threshold), _mm_cmpgt_epi32(sumHigh, threshold));
+    _mm_storel_epi64((__m128i*)(isEdge + i), _mm_packs_epi16(mask, mask));
+  }
+#endif
+
+  //-- Scalar fallback and the remaining samples
+  for (; i<count; ++i)
+  {
+    int sum = 0;
+    for (int c=0; c<3; ++c)
+    {
+      const short* t = &planes[(0*3 + c) * n + i];
+      const short* m = &planes[(1*3 + c) * n + i];
+      const short* b = &planes[(2*3 + c) * n + i];
+
+      const int vertical = ((b[0] + 2*b[1] + b[2]) - (t[0] + 2*t[1] + t[2])) / 4;
+      const int horizontal = ((t[2] + 2*m[2] + b[2]) - (t[0] + 2*m[0] + b[0])) / 4;
+      sum += vertical*vertical + horizontal*horizontal;
+    }
+    isEdge[i] = sum > EDGE_THRESHOLD_SQR;
+  }
 }
 
+#undef DIV4_EPI16
+#undef DIV4_EPI16_256
+
 #undef fixel
@@ -10,6 +10,7 @@
 #include <vector>
 #include "Tools/Math/Vector.h"
 #include "Representations/Infrastructure/Image.h"
+#include "WorkerPool.h"
 
 // [FIXME] : make these parameters
 #define expStep  0.0625
@@ -23,22 +24,103 @@ public:
 
   void update();
   const std::vector<Vector2i>& edgePoints() const { return _edgePoints; }
+
+  //-- Bands of scan rows are searched by that many threads, the edge points are the same for any number of them
+  void setThreads(unsigned threads);
   void refine(const Vector2i& point);
+
+  //-- Like refine, but any number of threads may call it at once, each with its own worker below
+  //-- setRefineThreads. The edges of the window the scan did not find are appended to `found', also the
+  //-- ones another call marked first, so the result does not depend on the other calls. They are not
+  //-- added to edgePoints().
+  void refine(const Vector2i& point, unsigned worker, std::vector<Vector2i>& found);
+  void setRefineThreads(unsigned threads);
+
+  //-- The y of the pixel (x, y), which tells whether it is an edge, also while refines are running
+  inline unsigned char state(int x, int y) const
+  {
+    Pixel p;
+    p.color = __atomic_load_n(&(*this)[y][x].color, __ATOMIC_RELAXED);
+    return p.y;
+  }
   static inline int edgeingStep(int y) { return y*expStep+expCStep; }
 
 
-  bool isCameraUpper; // [FIXME] : move this somewhere else
   int originY; // [FIXME] : move this somewhere else
   int avStep; // [FIXME] : this not quite good... :S
 
+  //-- Per column, only pixels with regionTop[x] <= y < regionBottom[x] are scanned and refined.
+  //-- Without a value for each column the whole image is.
+  std::vector<int> regionTop;
+  std::vector<int> regionBottom;
+
 private:
   const Image& _image;
-  std::vector<std::vector<Vector2i> > _scanGraphLookup;
+
+  //-- Scan graph of one camera resolution, in image coordinates except for the y of the rows
+  class ScanGraph
+  {
+  public:
+    int imageWidth, imageHeight, avStep; //-- The resolution it was made for
+    std::vector<int> rowY;     //-- Of each row, originY has to be added before dividing by avStep
+    std::vector<int> rowStart; //-- Row r is columns[rowStart[r], rowStart[r+1]), its samples with their left and right neighbours
+    std::vector<int> columns;
+    std::vector<int> first;    //-- Samples [first, last) of a row have both horizontal neighbours inside the image
+    std::vector<int> last;
+
+    inline int count(int row) const { return rowStart[row+1] - rowStart[row] - 2; }
+    inline int y(int row, int originY) const { return (rowY[row] + originY) / avStep; }
+  };
+  std::vector<ScanGraph> _scanGraphs; //-- One per resolution, switching cameras does not rebuild anything
+  int _scanGraph;                     //-- Of the current resolution
   std::vector<Vector2i> _edgePoints; // [TODO] : make this raw array
 
   static Pixel black;
   static Pixel red;
+  static Pixel edge;      //-- Result of the scan graph for edges
+  static Pixel processed; //-- Result of the scan graph for non-edges
+
+  //-- Pixels written during the last frame, only these are set back to black by the next update
+  std::vector<Vector2i> _scannedRows; //-- (row of the scan graph, y)
+  int _scannedGraph;                  //-- The scan graph of _scannedRows
+  std::vector<int> _refinedBegin;     //-- Columns [begin, end) of each row covered by refine windows, as the windows overlap
+  std::vector<int> _refinedEnd;
+
+  //-- Scan rows [firstRow, lastRow) searched by one job of update, its results are appended in the order of the bands
+  class Band
+  {
+  public:
+    int firstRow, lastRow;
+    std::vector<Vector2i> edgePoints;
+    std::vector<Vector2i> scannedRows;
+  };
+  std::vector<Band> _bands;
+
+  //-- Buffers of one thread, kept to avoid allocations per row
+  class Scratch
+  {
+  public:
+    std::vector<short> planes; //-- Of calculateEdges
+    std::vector<unsigned char> isEdge;
+    std::vector<int> columns;
+
+    class Window
+    {
+    public:
+      int startX, startY, endX, endY;
+    };
+    std::vector<Window> refinedWindows; //-- Of the concurrent refine, added to the spans above by clearWritten
+  };
+  std::vector<Scratch> _scratch; //-- One per worker of update or of the concurrent refine, the other refine uses the first
+  WorkerPool* _workers;          //-- Only with more than one thread
+  unsigned _updateThreads, _refineThreads;
 
-  const Pixel& calculateEdge(const Vector2i& topLeft, const Vector2i& middle, const Vector2i& bottomRight);
+  Pixel calculateEdge(const Vector2i& topLeft, const Vector2i& middle, const Vector2i& bottomRight, std::vector<Vector2i>& edgePoints);
+  void calculateEdges(const int* columns, int count, int top, int middle, int bottom, unsigned char* isEdge, std::vector<short>& planes);
+  void scanBand(Band& band, Scratch& scratch, bool masked);
+  bool refineWindow(const Vector2i& point, int& startX, int& startY, int& endX, int& endY) const;
   void createLookup();
+  void clearWritten();
+  inline bool hasRegion() const { return (int)regionTop.size() == width && (int)regionBottom.size() == width; }
+  inline bool inRegion(int x, int y) const { return regionTop[x] <= y && y < regionBottom[x]; }
 };
@@ -6,31 +6,84 @@
  */
 
 #include "FRHT.h"
+#include "Instrumentation.h"
+#include <algorithm>
 #include <ctime>
 #include "Tools/Debugging/DebugDrawings.h"
+#include "Tools/Debugging/Stopwatch.h"
 
 // [TODO] : make these configurable parameters
-#define FRHT_ITERATIONS 150
+#define FRHT_MAX_CANDIDATES 64
+#define FRHT_MERGE_DISTANCE 2 //-- Circles closer than this in center and radius vote for the same candidate
+#define FRHT_TABLE_STEP 64    //-- Largest step of findCircle with all its distances in the table, others are calculated
+#define FRHT_GRID_BUCKETS 1024 //-- Of the clusters, has to be a power of two
 
 FRHT::FRHT(EdgeImage& image) :
-  _image(image)
+  maxCandidates(FRHT_MAX_CANDIDATES),
+  iterations(FRHT_ITERATIONS),
+  anytime(false),
+  _image(image),
+  _gridBuckets(FRHT_GRID_BUCKETS),
+  _gridStamps(FRHT_GRID_BUCKETS, 0),
+  _gridUpdate(0),
+  _workers(0),
+  _scratch(1),
+  _frameSeed(0),
+  _iterationsRun(0)
 {
   srand(time(0));
+
+  _distances.resize(2 * FRHT_TABLE_STEP*FRHT_TABLE_STEP);
+  for (int d=0; d<(int)_distances.size(); ++d)
+    _distances[d] = sqrt(d);
 }
 
 FRHT::~FRHT()
 {
+  delete _workers;
+}
+
+void FRHT::setThreads(unsigned threads)
+{
+  delete _workers;
+  _workers = threads ? new WorkerPool(threads) : 0;
+  _scratch.resize(_workers ? _workers->size() : 1);
+  _image.setRefineThreads(_workers ? _workers->size() : 1);
 }
 
 void FRHT::update()
 {
+  INSTRUMENT_SCOPE("frht.update");
   _circles.clear();
+  _votes.clear();
+  _clusters.clear();
+  if (++_gridUpdate == 0)
+  {
+    std::fill(_gridStamps.begin(), _gridStamps.end(), 0);
+    _gridUpdate = 1;
+  }
+  _iterationsRun = 0;
 
   if (!_image.edgePoints().size())
     return;
 
-  const int maxIterations = _image.isCameraUpper?FRHT_ITERATIONS:FRHT_ITERATIONS/5;
-  for (unsigned i=0; i<maxIterations; ++i)
+  if (_workers)
+  {
+    //-- Merged in the order of the iterations, as if they had run one after another
+    _frameSeed = rand();
+    _iterationFound.resize(std::max<size_t>(_iterationFound.size(), iterations));
+    _workers->run(iterations, [this](unsigned iteration, unsigned worker) { iterate(iteration, worker); });
+    for (unsigned i=0; i<iterations; ++i)
+      for (const Vector3f& circle : _iterationFound[i])
+      {
+        addCircle(circle);
+        CIRCLE("module:BallPerceptor:houghPoints", circle.x, circle.y, circle.z, 1, Drawings::bs_solid, ColorClasses::blue, Drawings::bs_null, ColorClasses::blue);
+      }
+    rankCircles();
+    return;
+  }
+
+  for (unsigned i=0; i<iterations && !pastDeadline(i); ++i, ++_iterationsRun)
   {
     const int edgePointsLastIndex = _image.edgePoints().size();
     int randomID = rand() % edgePointsLastIndex;
@@ -39,7 +92,7 @@ void FRHT::update()
     RECTANGLE("module:BallPerceptor:selectedPoints", point.x-step, point.y-step, point.x+step, point.y+step, 1, Drawings::bs_solid, ColorClasses::blue);
 
 
-    _image.refine(point);
+    STOP_TIME_ON_REQUEST("module:BallPerceptor:refine", _image.refine(point); );
 
     const int additionalPoints = _image.edgePoints().size() - edgePointsLastIndex;
     if (additionalPoints > 0)
@@ -48,31 +101,65 @@ void FRHT::update()
       point = _image.edgePoints().at(randomID);
       step = EdgeImage::edgeingStep(point.y-_image.originY) / 2;
       CIRCLE("module:BallPerceptor:selectedPoints", point.x, point.y, 3, 1, Drawings::bs_solid, ColorClasses::yellow, Drawings::bs_null, ColorClasses::yellow);
-      _image.refine(point);
+      STOP_TIME_ON_REQUEST("module:BallPerceptor:refine", _image.refine(point); );
     }
 
-    findCircle(point, step);
+    RECTANGLE("module:BallPerceptor:selectedPoints", point.x-step, point.y-step, point.x+step, point.y+step, 1, Drawings::bs_solid, ColorClasses::orange);
+    _found.clear();
+    STOP_TIME_ON_REQUEST("module:BallPerceptor:findCircle", findCircle(point, step, _found, _scratch[0]); );
+    for (const Vector3f& circle : _found)
+    {
+      addCircle(circle);
+      CIRCLE("module:BallPerceptor:houghPoints", circle.x, circle.y, circle.z, 1, Drawings::bs_solid, ColorClasses::blue, Drawings::bs_null, ColorClasses::blue);
+    }
 
   }
 
+  rankCircles();
+
 //  for (const auto& p : _image.edgePoints())
 //  const Vector2i& p = _image.edgePoints().at(id);
 //    _image.refine(p);
 }
 
-void FRHT::findCircle(const Vector2i& centerPoint, int step)
+void FRHT::iterate(unsigned iteration, unsigned worker)
 {
-  RECTANGLE("module:BallPerceptor:selectedPoints", centerPoint.x-step, centerPoint.y-step, centerPoint.x+step, centerPoint.y+step, 1, Drawings::bs_solid, ColorClasses::orange);
+  //-- The same steps as an iteration of update, without drawings and stopwatches as they are not thread safe
+  Random random(_frameSeed ^ (unsigned long long)iteration * 0xD1B54A32D192ED03ull);
+  std::vector<Vector2i>& refined = _scratch[worker].refined;
+  std::vector<Vector3f>& found = _iterationFound[iteration];
+  found.clear();
+  if (pastDeadline(iteration))
+    return;
+  _iterationsRun.fetch_add(1, std::memory_order_relaxed);
 
-  class SearchCell {
-  public:
-    SearchCell(int Distance, const Vector2i& Point) : distance(Distance), point(Point) {}
-    int      distance;
-    Vector2i point;
-    // int score;
-  };
+  Vector2i point = _image.edgePoints()[random.next() % _image.edgePoints().size()];
+  refined.clear();
+  _image.refine(point, worker, refined);
 
-  std::vector<SearchCell> searchPoints;
+  if (!refined.empty())
+  {
+    point = refined[random.next() % refined.size()];
+    refined.clear();
+    _image.refine(point, worker, refined);
+  }
+
+  findCircle(point, EdgeImage::edgeingStep(point.y-_image.originY) / 2, found, _scratch[worker]);
+}
+
+void FRHT::findCircle(const Vector2i& centerPoint, int step, std::vector<Vector3f>& found, Scratch& scratch)
+{
+  INSTRUMENT_SCOPE("frht.findCircle");
+  const int foundBefore = found.size();
+
+  //-- A new call invalidates all the distances at once
+  if (++scratch.call == 0)
+  {
+    std::fill(scratch.stamp.begin(), scratch.stamp.end(), 0);
+    scratch.call = 1;
+  }
+  scratch.points.clear();
+  scratch.next.clear();
 
   // [FIXME] : there is a bug here, sometimes one point is pushed in some place with no edge in.
 
@@ -80,32 +167,164 @@ void FRHT::findCircle(const Vector2i& centerPoint, int step)
   for (int y=centerPoint.y-step; y<centerPoint.y+step; ++y)
     for (int x=centerPoint.x-step; x<centerPoint.x+step; ++x)
     {
-      if (x < 0 || y < 0 || x > _image.width || y > _image.height)
+      if (x < 0 || y < 0 || x >= _image.width || y >= _image.height)
         continue;
 
-      if (_image[y][x].y < 127)
+      if (_image.state(x, y) < 127)
         continue;
 
-      // [TODO] : make this one lookup table in order to speed up
-      const int distance = sqrt((x-centerPoint.x)*(x-centerPoint.x) + (y-centerPoint.y)*(y-centerPoint.y));
+      const int squaredDistance = (x-centerPoint.x)*(x-centerPoint.x) + (y-centerPoint.y)*(y-centerPoint.y);
+      const int distance = squaredDistance < (int)_distances.size() ? _distances[squaredDistance] : (int)sqrt(squaredDistance);
+      if (distance >= (int)scratch.stamp.size())
+      {
+        scratch.stamp.resize(distance + 1, 0);
+        scratch.first.resize(distance + 1);
+        scratch.last.resize(distance + 1);
+      }
 
-      for (const auto& sp : searchPoints)
-        if (sp.distance == distance)
-        {
-          checkCircle(centerPoint, sp.point, Vector2i(x, y));
+      //-- Every earlier point at the same distance, in the order they were found
+      const bool known = scratch.stamp[distance] == scratch.call;
+      for (int i=known ? scratch.first[distance] : -1; i>=0; i=scratch.next[i])
+      {
+        checkCircle(centerPoint, scratch.points[i], Vector2i(x, y), found);
 //          return; // [FIXME] : check to see if it better to stop after first distance pair or not.
-        }
+      }
 
-      searchPoints.push_back(SearchCell(distance, Vector2i(x, y)));
+      const int index = scratch.points.size();
+      scratch.points.push_back(Vector2i(x, y));
+      scratch.next.push_back(-1);
+      if (known)
+        scratch.next[scratch.last[distance]] = index;
+      else
+      {
+        scratch.stamp[distance] = scratch.call;
+        scratch.first[distance] = index;
+      }
+      scratch.last[distance] = index;
       y+=2;
     }
+  INSTRUMENT_COUNT("frht.findCircle", found.size() - foundBefore);
 }
 
-void FRHT::checkCircle(const Vector2i p1, const Vector2i p2, const Vector2i p3)
+void FRHT::checkCircle(const Vector2i p1, const Vector2i p2, const Vector2i p3, std::vector<Vector3f>& found)
 {
   Vector3f circle = fitACircle(p1, p2, p3);
-  _circles.push_back(circle);
-  CIRCLE("module:BallPerceptor:houghPoints", circle.x, circle.y, circle.z, 1, Drawings::bs_solid, ColorClasses::blue, Drawings::bs_null, ColorClasses::blue);
+
+  //-- Collinear points give no circle at all
+  if (!std::isfinite(circle.x) || !std::isfinite(circle.y) || !std::isfinite(circle.z) ||
+      circle.z > std::max(_image.width, _image.height))
+    return;
+
+  found.push_back(circle);
+}
+
+long long FRHT::gridKey(const Vector3f& circle, int dx, int dy, int dr) const
+{
+  //-- Cells are as large as the merging distance, so a mean close enough is always in a neighbour cell.
+  //   Clamping keeps neighbours neighbours, circles far outside only share a few cells.
+  const float limit = 1 << 19;
+  const long long qx = (long long)std::max(-limit, std::min(limit, std::floor(circle.x / FRHT_MERGE_DISTANCE))) + dx;
+  const long long qy = (long long)std::max(-limit, std::min(limit, std::floor(circle.y / FRHT_MERGE_DISTANCE))) + dy;
+  const long long qr = (long long)std::max(-limit, std::min(limit, std::floor(circle.z / FRHT_MERGE_DISTANCE))) + dr;
+  return ((qx + (1 << 20)) << 42) | ((qy + (1 << 20)) << 21) | (qr + (1 << 20));
+}
+
+int& FRHT::gridBucket(long long key)
+{
+  const int bucket = (int)(((unsigned long long)key * 0x9E3779B97F4A7C15ull) >> 54) & (FRHT_GRID_BUCKETS - 1);
+  if (_gridStamps[bucket] != _gridUpdate)
+  {
+    _gridStamps[bucket] = _gridUpdate;
+    _gridBuckets[bucket] = -1;
+  }
+  return _gridBuckets[bucket];
+}
+
+void FRHT::linkToGrid(int index)
+{
+  Cluster& cluster = _clusters[index];
+  int& head = gridBucket(cluster.key);
+  cluster.next = head;
+  head = index;
+}
+
+void FRHT::unlinkFromGrid(int index)
+{
+  int* link = &gridBucket(_clusters[index].key);
+  while (*link != index)
+    link = &_clusters[*link].next;
+  *link = _clusters[index].next;
+}
+
+void FRHT::addCircle(const Vector3f& circle)
+{
+  //-- The closest cluster around, the first one found of those as close
+  int best = -1;
+  float bestDistance = 0;
+  for (int dx=-1; dx<=1; ++dx)
+    for (int dy=-1; dy<=1; ++dy)
+      for (int dr=-1; dr<=1; ++dr)
+      {
+        const long long key = gridKey(circle, dx, dy, dr);
+        for (int i=gridBucket(key); i>=0; i=_clusters[i].next)
+        {
+          if (_clusters[i].key != key)
+            continue;
+
+          const Vector3f d = _clusters[i].mean() - circle;
+          if (std::abs(d.x) > FRHT_MERGE_DISTANCE || std::abs(d.y) > FRHT_MERGE_DISTANCE || std::abs(d.z) > FRHT_MERGE_DISTANCE)
+            continue;
+
+          const float distance = d.x*d.x + d.y*d.y + d.z*d.z;
+          if (best < 0 || distance < bestDistance || (distance == bestDistance && i < best))
+          {
+            best = i;
+            bestDistance = distance;
+          }
+        }
+      }
+
+  if (best >= 0)
+  {
+    Cluster& cluster = _clusters[best];
+    cluster.sum = cluster.sum + circle;
+    cluster.votes++;
+
+    //-- The mean may have moved to another cell
+    const long long key = gridKey(cluster.mean(), 0, 0, 0);
+    if (key != cluster.key)
+    {
+      unlinkFromGrid(best);
+      cluster.key = key;
+      linkToGrid(best);
+    }
+    return;
+  }
+
+  //-- Several clusters may share a cell, no circle is ever dropped
+  _clusters.push_back(Cluster(circle));
+  _clusters.back().key = gridKey(circle, 0, 0, 0);
+  linkToGrid(_clusters.size() - 1);
+}
+
+void FRHT::rankCircles()
+{
+  //-- Most votes first, ties in the order they were found
+  _ranking.resize(_clusters.size());
+  for (unsigned i=0; i<_ranking.size(); ++i)
+    _ranking[i] = i;
+
+  const unsigned count = (maxCandidates && maxCandidates < _ranking.size()) ? maxCandidates : _ranking.size();
+  std::partial_sort(_ranking.begin(), _ranking.begin() + count, _ranking.end(), [this](int a, int b)
+  {
+    return _clusters[a].votes != _clusters[b].votes ? _clusters[a].votes > _clusters[b].votes : a < b;
+  });
+
+  for (unsigned i=0; i<count; ++i)
+  {
+    _circles.push_back(_clusters[_ranking[i]].mean());
+    _votes.push_back(_clusters[_ranking[i]].votes);
+  }
 }
 
 const std::vector<Vector3f>& FRHT::extractedCircles() const
@@ -8,8 +8,15 @@
 #pragma once
 
 #include "EdgeImage.h"
+#include "WorkerPool.h"
+#include <atomic>
+#include <chrono>
 #include <cmath>
 
+// [TODO] : make these configurable parameters
+#define FRHT_ITERATIONS 150                       //-- Of the upper camera
+#define FRHT_LOWER_ITERATIONS (FRHT_ITERATIONS/5) //-- Of the lower camera
+
 class FRHT
 {
 public:
@@ -17,14 +24,100 @@ public:
   ~FRHT();
 
   void update();
+
+  //-- Circles sorted by their votes, at most maxCandidates of them
   const std::vector<Vector3f>& extractedCircles() const;
+  const std::vector<int>& extractedVotes() const { return _votes; }
+
+  unsigned maxCandidates; //-- Number of circles passed on to the verification, 0 for all
+  unsigned iterations;    //-- Random points searched for circles in each frame
+
+  //-- Without threads the iterations run one after another and draw from rand(). With them, they run
+  //-- concurrently on that many threads, each with a generator of its own seeded from one rand() per
+  //-- frame, and the circles do not depend on the number of threads. Their first points are then only
+  //-- drawn from the edges of the scan, not from the ones found by the refines of the other iterations.
+  void setThreads(unsigned threads);
+
+  //-- In the anytime mode no iteration starts after the deadline, iterations is only their upper bound then.
+  //-- At least one iteration runs anyway. Concurrent iterations starting too late are skipped, so the circles
+  //-- depend on the timing.
+  bool anytime;
+  std::chrono::steady_clock::time_point deadline;
+  unsigned iterationsRun() const { return _iterationsRun; } //-- Of the last update
 
 private:
+  //-- Circles found near each other, merged into their mean
+  class Cluster
+  {
+  public:
+    Cluster(const Vector3f& circle) : sum(circle), votes(1), key(0), next(-1) {}
+    Vector3f mean() const { return sum / (float)votes; }
+    Vector3f sum;
+    int votes;
+    long long key; //-- Cell of the mean
+    int next;      //-- Next cluster in the same bucket, or -1
+  };
+
   EdgeImage& _image;
   std::vector<Vector3f> _circles;
-
-  void findCircle(const Vector2i& centerPoint, int step);
-  void checkCircle(const Vector2i p1, const Vector2i p2, const Vector2i p3);
+  std::vector<int> _votes;
+  std::vector<Cluster> _clusters;
+  //-- Clusters hashed by the cell of their mean, chained through Cluster::next. A bucket is only valid if its
+  //-- stamp is _gridUpdate, so nothing has to be cleared for a new update.
+  std::vector<int> _gridBuckets;
+  std::vector<unsigned> _gridStamps;
+  unsigned _gridUpdate;
+  std::vector<int> _ranking;
+  std::vector<Vector3f> _found; //-- Circles of the current iteration
+
+  //-- SplitMix64, small and good enough for drawing points, with one state per iteration
+  class Random
+  {
+  public:
+    Random(unsigned long long seed) : state(seed) {}
+    inline unsigned next()
+    {
+      unsigned long long z = (state += 0x9E3779B97F4A7C15ull);
+      z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+      z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+      return (unsigned)((z ^ (z >> 31)) >> 32);
+    }
+    unsigned long long state;
+  };
+
+  //-- Buffers of one thread, kept from one call to the next
+  class Scratch
+  {
+  public:
+    Scratch() : call(0) {}
+
+    std::vector<Vector2i> refined; //-- Edges found by the refines of the concurrent mode
+
+    //-- Edge points of the window of findCircle, chained in the order they were found by their distance to the center
+    std::vector<Vector2i> points;
+    std::vector<int> next;         //-- Next point at the same distance, or -1
+    std::vector<int> first, last;  //-- By distance, only valid if stamp is call
+    std::vector<unsigned> stamp;
+    unsigned call;
+  };
+
+  WorkerPool* _workers;                               //-- Only in the concurrent mode
+  std::vector<std::vector<Vector3f> > _iterationFound; //-- Circles of each iteration of the concurrent mode
+  std::vector<Scratch> _scratch;                       //-- One per worker, update uses the first
+  unsigned long long _frameSeed;
+  std::atomic<unsigned> _iterationsRun;
+  std::vector<unsigned char> _distances;               //-- (int)sqrt of each squared distance up to the size of a large window
+
+  bool pastDeadline(unsigned iteration) const { return anytime && iteration && std::chrono::steady_clock::now() >= deadline; }
+  void iterate(unsigned iteration, unsigned worker);
+  void findCircle(const Vector2i& centerPoint, int step, std::vector<Vector3f>& found, Scratch& scratch);
+  void checkCircle(const Vector2i p1, const Vector2i p2, const Vector2i p3, std::vector<Vector3f>& found);
+  void addCircle(const Vector3f& circle);
+  long long gridKey(const Vector3f& circle, int dx, int dy, int dr) const;
+  int& gridBucket(long long key);
+  void linkToGrid(int index);
+  void unlinkFromGrid(int index);
+  void rankCircles();
 
 
 
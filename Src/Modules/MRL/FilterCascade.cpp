@@ -0,0 +1,96 @@
+/**
+ * @file FilterCascade.cpp
+ * A chain of checks which all have to pass, ordered by their rejections per microsecond
+ * @author <a href="mailto:agent@local">agent</a>
+ * @date Oct 2026
+ */
+
+#include "FilterCascade.h"
+#include "Instrumentation.h"
+#include <algorithm>
+
+FilterCascade::FilterCascade() :
+  adaptive(true),
+  reorderInterval(30),
+  _frames(0)
+{
+}
+
+void FilterCascade::add(const char* name, const Check& check)
+{
+  _stages.push_back(Stage(name, check));
+  _counters.reset(new Counters[_stages.size()]);
+}
+
+bool FilterCascade::run(float x, float y, float r)
+{
+  //-- Each stage is timed here only, for its place in the order and for the instrumentation. In RELEASE
+  //-- there is no instrumentation, so without reordering the stages are not timed at all.
+#ifdef RELEASE
+  const bool timed = adaptive;
+#else
+  const bool timed = true;
+#endif
+
+  for (unsigned i=0; i<_stages.size(); ++i)
+  {
+    const Stage& stage = _stages[i];
+    Counters& counters = _counters[i];
+    bool passed;
+    if (timed)
+    {
+      const unsigned long long start = Instrumentation::now();
+      passed = stage.check(x, y, r);
+      const unsigned long long duration = Instrumentation::now() - start;
+      INSTRUMENT_RECORD(stage.name, start, duration);
+      counters.time.fetch_add(duration, std::memory_order_relaxed);
+    }
+    else
+      passed = stage.check(x, y, r);
+    INSTRUMENT_COUNT(stage.name, !passed); //-- Rejections
+
+    counters.calls.fetch_add(1, std::memory_order_relaxed);
+    if (!passed)
+    {
+      counters.rejections.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+  }
+  return true;
+}
+
+void FilterCascade::newFrame()
+{
+  for (unsigned i=0; i<_stages.size(); ++i)
+  {
+    Counters& counters = _counters[i];
+    _stages[i].calls += counters.calls.exchange(0, std::memory_order_relaxed);
+    _stages[i].rejections += counters.rejections.exchange(0, std::memory_order_relaxed);
+    _stages[i].time += counters.time.exchange(0, std::memory_order_relaxed) / 1000.f;
+  }
+
+  //-- The counters are all zero now, so the stages can be moved without them
+  if (adaptive && ++_frames >= reorderInterval)
+  {
+    _frames = 0;
+    reorder();
+  }
+}
+
+void FilterCascade::reorder()
+{
+  //-- Stages that have not been run are not worth anything yet, they go to the end
+  std::stable_sort(_stages.begin(), _stages.end(), [](const Stage& a, const Stage& b)
+  {
+    const float scoreA = a.calls ? a.rejections / std::max(a.time, 0.01f) : -1.f;
+    const float scoreB = b.calls ? b.rejections / std::max(b.time, 0.01f) : -1.f;
+    return scoreA > scoreB;
+  });
+
+  for (Stage& stage : _stages)
+  {
+    stage.calls /= 2;
+    stage.rejections /= 2;
+    stage.time /= 2;
+  }
+}
@@ -0,0 +1,67 @@
+/**
+ * @file FilterCascade.h
+ * A chain of checks which all have to pass. Each stage keeps track of its
+ * cost and how often it rejects, so that the chain can be run with the
+ * stages rejecting the most per microsecond first. As all the checks have
+ * to pass, the order only changes the cost, never the result.
+ * @author <a href="mailto:agent@local">agent</a>
+ * @date Oct 2026
+ */
+
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+class FilterCascade
+{
+public:
+  typedef std::function<bool(float x, float y, float r)> Check;
+
+  class Stage
+  {
+  public:
+    Stage(const char* name, const Check& check) : name(name), check(check), calls(0), rejections(0), time(0) {}
+
+    const char* name;
+    Check check;
+    float calls;      //-- These three decay at every reordering, so that the order follows the recent frames.
+    float rejections; //   They are only updated by newFrame.
+    float time;       //-- Microseconds
+  };
+
+  FilterCascade();
+
+  void add(const char* name, const Check& check);
+
+  //-- True if the circle passed all the stages. May run on several threads at once, as long as the checks may
+  bool run(float x, float y, float r);
+
+  //-- Has to be called once per frame and not while run is, adds the counts of the frame to the stages and
+  //-- reorders them every reorderInterval frames if adaptive
+  void newFrame();
+
+  //-- Stages in the order they are run
+  const std::vector<Stage>& stages() const { return _stages; }
+
+  bool adaptive;            //-- Otherwise the stages are run in the order they were added
+  unsigned reorderInterval; //-- Frames
+
+private:
+  //-- Of the running frame, by the index of the stage, the workers only add to them
+  class Counters
+  {
+  public:
+    Counters() : calls(0), rejections(0), time(0) {}
+    std::atomic<unsigned> calls, rejections;
+    std::atomic<unsigned long long> time; //-- ns
+  };
+
+  std::vector<Stage> _stages;
+  std::unique_ptr<Counters[]> _counters;
+  unsigned _frames;
+
+  void reorder();
+};
@@ -0,0 +1,154 @@
+/**
+ * @file FrameRecorder.cpp
+ * Writes a FrameRecording without blocking the thread recording the frames.
+ * @author <a href="mailto:agent@local">agent</a>
+ * @date Oct 2026
+ */
+
+#include "FrameRecorder.h"
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+FrameRecorder::FrameRecorder() :
+  waitForWriter(false),
+  _file(0),
+  _head(0),
+  _tail(0),
+  _frame(0),
+  _written(0),
+  _dropped(0),
+  _stop(false)
+{
+}
+
+FrameRecorder::~FrameRecorder()
+{
+  close();
+}
+
+bool FrameRecorder::open(const std::string& path)
+{
+  close();
+  _file = fopen(path.c_str(), "w+b");
+  if (!_file)
+  {
+    std::cerr << "Can not create recording " << path << "\n";
+    return false;
+  }
+
+  //-- Without frames and index until it is closed, so a recording that was not closed can still be read
+  std::vector<unsigned char> page(FRAME_RECORDING_PAGE, 0);
+  FrameRecording::Header& header = *(FrameRecording::Header*) page.data();
+  header.magic = FRAME_RECORDING_MAGIC;
+  header.version = FRAME_RECORDING_VERSION;
+  header.pageSize = FRAME_RECORDING_PAGE;
+  header.recordSize = FrameRecording::recordSize;
+  header.maxWidth = Image::maxResolutionWidth;
+  header.maxHeight = Image::maxResolutionHeight;
+  fwrite(page.data(), page.size(), 1, _file);
+
+  _ring.resize((size_t) FRAME_RECORDER_RING * FrameRecording::recordSize);
+  _index.clear();
+  _head = _tail = 0;
+  _frame = 0;
+  _stop = false;
+  _writer = std::thread(&FrameRecorder::write, this);
+  return true;
+}
+
+void FrameRecorder::close()
+{
+  if (!_file)
+    return;
+
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stop = true;
+  }
+  _wake.notify_one();
+  _writer.join();
+
+  //-- The index after the last record, then the header pointing to it
+  FrameRecording::Header header;
+  fseek(_file, 0, SEEK_SET);
+  if (fread(&header, sizeof(header), 1, _file) == 1)
+  {
+    fseek(_file, 0, SEEK_END);
+    header.frames = _index.size();
+    header.indexOffset = ftell(_file);
+    fwrite(_index.data(), sizeof(FrameRecording::Entry), _index.size(), _file);
+    fseek(_file, 0, SEEK_SET);
+    fwrite(&header, sizeof(header), 1, _file);
+  }
+
+  fclose(_file);
+  _file = 0;
+  _ring.clear();
+  _ring.shrink_to_fit();
+}
+
+bool FrameRecorder::record(const Image& image, const CameraInfo& cameraInfo, const CameraMatrix& cameraMatrix, const ImageCoordinateSystem& imageCoordinateSystem,
+                           const FieldBoundary& fieldBoundary, const BodyContour& bodyContour, const ColorReference& colorReference)
+{
+  const unsigned frame = _frame++;
+  const unsigned head = _head.load(std::memory_order_relaxed);
+  while (waitForWriter && _file && head - _tail.load(std::memory_order_acquire) >= FRAME_RECORDER_RING)
+    std::this_thread::yield();
+  if (!_file || head - _tail.load(std::memory_order_acquire) >= FRAME_RECORDER_RING)
+  {
+    ++_dropped;
+    return false;
+  }
+
+  unsigned char* record = &_ring[(size_t) (head % FRAME_RECORDER_RING) * FrameRecording::recordSize];
+  FrameRecording::Context& context = *(FrameRecording::Context*) record;
+  FrameRecording::toContext(image, cameraInfo, cameraMatrix, imageCoordinateSystem, fieldBoundary, bodyContour, colorReference, context);
+  context.frame = frame;
+
+  //-- Only the pixels of the image, the rest of its rows is never read
+  Image::Pixel* pixels = (Image::Pixel*) (record + FRAME_RECORDING_PAGE);
+  for (int y=0; y<image.height; ++y)
+    memcpy(pixels + y * Image::maxResolutionWidth, image[y], image.width * sizeof(Image::Pixel));
+
+  _head.store(head + 1, std::memory_order_release);
+  return true;
+}
+
+void FrameRecorder::write()
+{
+  std::unique_lock<std::mutex> lock(_mutex);
+  while (!_stop)
+  {
+    lock.unlock();
+    writeBatch();
+    lock.lock();
+    _wake.wait_for(lock, std::chrono::milliseconds(FRAME_RECORDER_WRITE_PERIOD), [this] { return _stop; });
+  }
+  lock.unlock();
+  writeBatch();
+}
+
+void FrameRecorder::writeBatch()
+{
+  const unsigned head = _head.load(std::memory_order_acquire);
+  unsigned tail = _tail.load(std::memory_order_relaxed);
+  if (tail == head)
+    return;
+
+  for (; tail != head; ++tail)
+  {
+    const unsigned char* record = &_ring[(size_t) (tail % FRAME_RECORDER_RING) * FrameRecording::recordSize];
+    const FrameRecording::Context& context = *(const FrameRecording::Context*) record;
+    FrameRecording::Entry entry;
+    entry.frame = context.frame;
+    entry.timeStamp = context.timeStamp;
+    entry.camera = context.camera;
+    _index.push_back(entry);
+
+    fwrite(record, FrameRecording::recordSize, 1, _file);
+    ++_written;
+    _tail.store(tail + 1, std::memory_order_release);
+  }
+  fflush(_file);
+}
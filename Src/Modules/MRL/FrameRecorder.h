@@ -0,0 +1,66 @@
+/**
+ * @file FrameRecorder.h
+ * Writes a FrameRecording without blocking the thread recording the frames.
+ * Frames are copied into a preallocated ring of whole records and a thread of
+ * the recorder appends them to the file. When the ring is full, new frames
+ * are dropped.
+ * @author <a href="mailto:agent@local">agent</a>
+ * @date Oct 2026
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "FrameRecording.h"
+
+#define FRAME_RECORDER_RING 8           //-- Frames waiting for the writer, about 1.2 MB each
+#define FRAME_RECORDER_WRITE_PERIOD 20  //-- ms the writer sleeps between two batches
+
+class FrameRecorder
+{
+public:
+  FrameRecorder();
+  ~FrameRecorder();
+
+  //-- Starts the writer on a new file, false if it can not be created
+  bool open(const std::string& path);
+
+  //-- Writes the frames still waiting and the index, and stops the writer
+  void close();
+
+  bool isOpen() const { return _file != 0; }
+
+  //-- Waits for the writer instead of dropping frames, only for offline tools
+  bool waitForWriter;
+
+  //-- Copies the frame to the ring, from one thread only. Returns false if it was dropped because the
+  //-- ring is full or the recorder is not open.
+  bool record(const Image& image, const CameraInfo& cameraInfo, const CameraMatrix& cameraMatrix, const ImageCoordinateSystem& imageCoordinateSystem,
+              const FieldBoundary& fieldBoundary, const BodyContour& bodyContour, const ColorReference& colorReference);
+
+  unsigned long long written() const { return _written; }
+  unsigned long long dropped() const { return _dropped; }
+
+private:
+  FILE* _file;
+  std::vector<unsigned char> _ring; //-- FRAME_RECORDER_RING records
+  std::atomic<unsigned> _head;      //-- Frames put into the ring, only changed by record
+  std::atomic<unsigned> _tail;      //-- Frames written, only changed by the writer
+  unsigned _frame;
+  std::atomic<unsigned long long> _written, _dropped;
+  std::vector<FrameRecording::Entry> _index; //-- Of the written frames, only used by the writer
+
+  std::thread _writer;
+  std::mutex _mutex;                //-- Only for the writer sleeping, record never takes it
+  std::condition_variable _wake;
+  bool _stop;
+
+  void write();
+  void writeBatch();
+};
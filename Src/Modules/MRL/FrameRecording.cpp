@@ -0,0 +1,214 @@
+/**
+ * @file FrameRecording.cpp
+ * Recordings of full frames together with everything the BallPerceptor reads
+ * from the blackboard, for replaying it offline.
+ * @author <a href="mailto:agent@local">agent</a>
+ * @date Oct 2026
+ */
+
+#include "FrameRecording.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+#ifndef WINDOWS
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static_assert(sizeof(FrameRecording::Header) <= FRAME_RECORDING_PAGE, "The header has to fit into the first page");
+static_assert(sizeof(FrameRecording::Context) <= FRAME_RECORDING_PAGE, "The context has to fit into the first page of a record");
+
+FrameRecording::FrameRecording() :
+  _data(0),
+  _size(0),
+  _frames(0),
+  _index(0)
+{
+}
+
+FrameRecording::~FrameRecording()
+{
+  close();
+}
+
+bool FrameRecording::open(const std::string& path)
+{
+  close();
+
+#ifndef WINDOWS
+  const int file = ::open(path.c_str(), O_RDONLY);
+  struct stat status;
+  if (file < 0 || fstat(file, &status) || status.st_size < FRAME_RECORDING_PAGE)
+  {
+    std::cerr << "Can not open recording " << path << "\n";
+    if (file >= 0)
+      ::close(file);
+    return false;
+  }
+
+  //-- The pages are read on the first access only, and kept by the system for the next replays
+  void* data = mmap(0, status.st_size, PROT_READ, MAP_SHARED, file, 0);
+  ::close(file);
+  if (data == MAP_FAILED)
+  {
+    std::cerr << "Can not map recording " << path << "\n";
+    return false;
+  }
+  madvise(data, status.st_size, MADV_SEQUENTIAL);
+  _data = (const unsigned char*) data;
+  _size = status.st_size;
+#else
+  std::ifstream file(path, std::ios::in | std::ios::binary);
+  _buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+  _data = _buffer.data();
+  _size = _buffer.size();
+#endif
+
+  const Header& header = *(const Header*) _data;
+  if (_size < FRAME_RECORDING_PAGE || header.magic != FRAME_RECORDING_MAGIC || header.version != FRAME_RECORDING_VERSION ||
+      header.pageSize != FRAME_RECORDING_PAGE || header.recordSize != recordSize ||
+      header.maxWidth != Image::maxResolutionWidth || header.maxHeight != Image::maxResolutionHeight)
+  {
+    std::cerr << "Unsupported recording " << path << "\n";
+    close();
+    return false;
+  }
+
+  if (header.indexOffset && header.indexOffset + header.frames * sizeof(Entry) <= _size)
+  {
+    _frames = header.frames;
+    _index = (const Entry*) (_data + header.indexOffset);
+    return true;
+  }
+
+  //-- Not closed, all the complete records there are
+  _frames = (_size - FRAME_RECORDING_PAGE) / recordSize;
+  while (_frames && context(_frames - 1).magic != FRAME_RECORD_MAGIC)
+    --_frames;
+  _ownIndex.resize(_frames);
+  for (unsigned i=0; i<_frames; ++i)
+  {
+    const Context& c = context(i);
+    _ownIndex[i].frame = c.frame;
+    _ownIndex[i].timeStamp = c.timeStamp;
+    _ownIndex[i].camera = c.camera;
+  }
+  _index = _ownIndex.data();
+  return true;
+}
+
+void FrameRecording::close()
+{
+#ifndef WINDOWS
+  if (_data)
+    munmap((void*) _data, _size);
+#endif
+  _buffer.clear();
+  _ownIndex.clear();
+  _data = 0;
+  _size = 0;
+  _frames = 0;
+  _index = 0;
+}
+
+void FrameRecording::fill(unsigned frame, Image& image, CameraInfo& cameraInfo, CameraMatrix& cameraMatrix, ImageCoordinateSystem& imageCoordinateSystem,
+                          FieldBoundary& fieldBoundary, BodyContour& bodyContour, ColorReference& colorReference) const
+{
+  const Context& c = context(frame);
+
+  image.setImage(pixels(frame));
+  image.setResolution(c.width, c.height);
+  image.timeStamp = c.timeStamp;
+
+  cameraInfo.camera = (CameraInfo::Camera) c.camera;
+  cameraInfo.width = c.width;
+  cameraInfo.height = c.height;
+  cameraInfo.focalLength = c.focalLength;
+  cameraInfo.opticalCenter = Vector2<>(c.opticalCenter[0], c.opticalCenter[1]);
+
+  cameraMatrix.rotation.c0 = Vector3<>(c.rotation[0], c.rotation[1], c.rotation[2]);
+  cameraMatrix.rotation.c1 = Vector3<>(c.rotation[3], c.rotation[4], c.rotation[5]);
+  cameraMatrix.rotation.c2 = Vector3<>(c.rotation[6], c.rotation[7], c.rotation[8]);
+  cameraMatrix.translation = Vector3<>(c.translation[0], c.translation[1], c.translation[2]);
+  cameraMatrix.isValid = c.cameraMatrixValid;
+
+  imageCoordinateSystem.origin = Vector2<>(c.origin[0], c.origin[1]);
+
+  fieldBoundary.isValid = c.fieldBoundaryValid;
+  fieldBoundary.boundaryInImage.resize(c.boundaryPoints);
+  for (int i=0; i<c.boundaryPoints; ++i)
+    fieldBoundary.boundaryInImage[i] = Vector2i(c.boundary[i][0], c.boundary[i][1]);
+
+  bodyContour.lines.resize(c.contourLines);
+  for (int i=0; i<c.contourLines; ++i)
+    bodyContour.lines[i] = BodyContour::Line(Vector2i(c.contour[i][0], c.contour[i][1]), Vector2i(c.contour[i][2], c.contour[i][3]));
+
+  ColorReference::Threshold* thresholds[4] = {&colorReference.thresholdGreen, &colorReference.thresholdWhite,
+                                              &colorReference.thresholdOrange, &colorReference.thresholdBlue};
+  for (int i=0; i<4; ++i)
+    *thresholds[i] = ColorReference::Threshold(c.thresholds[i][0], c.thresholds[i][1], c.thresholds[i][2],
+                                               c.thresholds[i][3], c.thresholds[i][4], c.thresholds[i][5]);
+  colorReference.changed = c.colorReferenceChanged;
+}
+
+void FrameRecording::toContext(const Image& image, const CameraInfo& cameraInfo, const CameraMatrix& cameraMatrix, const ImageCoordinateSystem& imageCoordinateSystem,
+                               const FieldBoundary& fieldBoundary, const BodyContour& bodyContour, const ColorReference& colorReference, Context& c)
+{
+  std::fill((unsigned char*) &c, (unsigned char*) (&c + 1), 0);
+  c.magic = FRAME_RECORD_MAGIC;
+  c.timeStamp = image.timeStamp;
+
+  c.camera = cameraInfo.camera;
+  c.width = image.width;
+  c.height = image.height;
+  c.focalLength = cameraInfo.focalLength;
+  c.opticalCenter[0] = cameraInfo.opticalCenter.x;
+  c.opticalCenter[1] = cameraInfo.opticalCenter.y;
+
+  const Vector3<>* columns[3] = {&cameraMatrix.rotation.c0, &cameraMatrix.rotation.c1, &cameraMatrix.rotation.c2};
+  for (int i=0; i<3; ++i)
+  {
+    c.rotation[i*3+0] = columns[i]->x;
+    c.rotation[i*3+1] = columns[i]->y;
+    c.rotation[i*3+2] = columns[i]->z;
+  }
+  c.translation[0] = cameraMatrix.translation.x;
+  c.translation[1] = cameraMatrix.translation.y;
+  c.translation[2] = cameraMatrix.translation.z;
+  c.cameraMatrixValid = cameraMatrix.isValid;
+
+  c.origin[0] = imageCoordinateSystem.origin.x;
+  c.origin[1] = imageCoordinateSystem.origin.y;
+
+  c.fieldBoundaryValid = fieldBoundary.isValid;
+  c.boundaryPoints = std::min<int>(fieldBoundary.boundaryInImage.size(), FRAME_RECORDING_BOUNDARY);
+  for (int i=0; i<c.boundaryPoints; ++i)
+  {
+    c.boundary[i][0] = fieldBoundary.boundaryInImage[i].x;
+    c.boundary[i][1] = fieldBoundary.boundaryInImage[i].y;
+  }
+
+  c.contourLines = std::min<int>(bodyContour.lines.size(), FRAME_RECORDING_CONTOUR);
+  for (int i=0; i<c.contourLines; ++i)
+  {
+    const BodyContour::Line& line = bodyContour.lines[i];
+    c.contour[i][0] = line.p1.x;
+    c.contour[i][1] = line.p1.y;
+    c.contour[i][2] = line.p2.x;
+    c.contour[i][3] = line.p2.y;
+  }
+
+  const ColorReference::Threshold* thresholds[4] = {&colorReference.thresholdGreen, &colorReference.thresholdWhite,
+                                                    &colorReference.thresholdOrange, &colorReference.thresholdBlue};
+  for (int i=0; i<4; ++i)
+  {
+    const ColorReference::Threshold& t = *thresholds[i];
+    const int values[6] = {t.minY, t.maxY, t.minCb, t.maxCb, t.minCr, t.maxCr};
+    std::copy(values, values + 6, c.thresholds[i]);
+  }
+  c.colorReferenceChanged = colorReference.changed;
+}
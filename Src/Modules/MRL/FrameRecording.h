@@ -0,0 +1,129 @@
+/**
+ * @file FrameRecording.h
+ * Recordings of full frames together with everything the BallPerceptor reads
+ * from the blackboard, for replaying it offline. The file starts with a page
+ * holding its header, followed by one record per frame. All the records have
+ * the same size: a page with the context of the frame and the pixels after it,
+ * in the rows of an image of the largest resolution. So every record starts
+ * on a page and the file can be mapped and its pixels used in place. An index
+ * of the frames is appended when the recording is closed.
+ * @author <a href="mailto:agent@local">agent</a>
+ * @date Oct 2026
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Representations/Infrastructure/Image.h"
+#include "Representations/Infrastructure/CameraInfo.h"
+#include "Representations/Perception/CameraMatrix.h"
+#include "Representations/Perception/ImageCoordinateSystem.h"
+#include "Representations/Perception/FieldBoundary.h"
+#include "Representations/Perception/BodyContour.h"
+#include "Representations/Perception/ColorReference.h"
+
+#define FRAME_RECORDING_MAGIC 0x524c524d  //-- "MRLR" in the file
+#define FRAME_RECORD_MAGIC 0x464c524d     //-- "MRLF" at the start of each record
+#define FRAME_RECORDING_VERSION 1
+#define FRAME_RECORDING_PAGE 4096         //-- Size of the file header and of the context of each record
+#define FRAME_RECORDING_BOUNDARY 64       //-- Points of the field boundary kept, the rest is dropped
+#define FRAME_RECORDING_CONTOUR 32        //-- Lines of the body contour kept, the rest is dropped
+
+class FrameRecording
+{
+public:
+  //-- The first page of the file
+  class Header
+  {
+  public:
+    uint32_t magic;
+    uint16_t version;
+    uint16_t pageSize;
+    uint32_t recordSize;   //-- Distance of two records, the first one starts after the first page
+    uint16_t maxWidth, maxHeight;
+    uint64_t frames;       //-- Only set when the recording was closed, 0 before
+    uint64_t indexOffset;  //-- Of the index in the file, 0 if it was not closed
+  };
+
+  //-- The first page of each record, the rest is the pixels
+  class Context
+  {
+  public:
+    uint32_t magic;
+    uint32_t frame;        //-- Of the recorder, missing ones were dropped
+    uint32_t timeStamp;    //-- Of the image
+
+    //-- CameraInfo
+    int32_t camera;
+    int32_t width, height;
+    float focalLength;
+    float opticalCenter[2];
+
+    //-- CameraMatrix, the rotation by columns
+    float rotation[9];
+    float translation[3];
+    uint8_t cameraMatrixValid;
+
+    uint8_t fieldBoundaryValid;
+    uint8_t colorReferenceChanged;
+    uint8_t reserved;
+
+    //-- ImageCoordinateSystem
+    float origin[2];
+
+    int32_t boundaryPoints;
+    int32_t boundary[FRAME_RECORDING_BOUNDARY][2];
+    int32_t contourLines;
+    int32_t contour[FRAME_RECORDING_CONTOUR][4]; //-- p1.x, p1.y, p2.x, p2.y
+
+    //-- Green, white, orange, blue: minimum and maximum of y, cb and cr
+    int32_t thresholds[4][6];
+  };
+
+  //-- One per record, after the last one
+  class Entry
+  {
+  public:
+    uint32_t frame;
+    uint32_t timeStamp;
+    uint32_t camera;
+  };
+
+  enum
+  {
+    pixelsSize = Image::maxResolutionWidth * Image::maxResolutionHeight * sizeof(Image::Pixel),
+    recordSize = FRAME_RECORDING_PAGE + (pixelsSize + FRAME_RECORDING_PAGE - 1) / FRAME_RECORDING_PAGE * FRAME_RECORDING_PAGE
+  };
+
+  FrameRecording();
+  ~FrameRecording();
+
+  //-- Maps the file, false if it is no recording. One that was not closed is read without its index.
+  bool open(const std::string& path);
+  void close();
+
+  unsigned frames() const { return _frames; }
+  const Entry& entry(unsigned frame) const { return _index[frame]; }
+  const Context& context(unsigned frame) const { return *(const Context*) record(frame); }
+  const unsigned char* pixels(unsigned frame) const { return record(frame) + FRAME_RECORDING_PAGE; }
+
+  //-- Sets the representations to the ones of the frame, the image refers to the pixels in the file
+  void fill(unsigned frame, Image& image, CameraInfo& cameraInfo, CameraMatrix& cameraMatrix, ImageCoordinateSystem& imageCoordinateSystem,
+            FieldBoundary& fieldBoundary, BodyContour& bodyContour, ColorReference& colorReference) const;
+
+  //-- The other way around, for the recorder
+  static void toContext(const Image& image, const CameraInfo& cameraInfo, const CameraMatrix& cameraMatrix, const ImageCoordinateSystem& imageCoordinateSystem,
+                        const FieldBoundary& fieldBoundary, const BodyContour& bodyContour, const ColorReference& colorReference, Context& context);
+
+private:
+  const unsigned char* _data;
+  size_t _size;
+  unsigned _frames;
+  const Entry* _index;
+  std::vector<Entry> _ownIndex; //-- Of a recording that was not closed
+  std::vector<unsigned char> _buffer; //-- The whole file, where it can not be mapped
+
+  const unsigned char* record(unsigned frame) const { return _data + FRAME_RECORDING_PAGE + (size_t) frame * recordSize; }
+};
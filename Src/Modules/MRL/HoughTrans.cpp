@@ -6,134 +6,457 @@
  */
 
 #include "HoughTrans.h"
+#include <algorithm>
 #include <iostream>
 #include <cmath>
 
 #include "Tools/RingBuffer.h"
+
+//-- Part of the votes of a full resolution peak its downsampled one needs to be refined
+#define PYRAMID_COARSE_SHARE 0.7
+//-- Smallest coarse radius, the smaller radii are searched at full resolution as lines give their few offsets peaks everywhere
+#define PYRAMID_MIN_RADIUS 6
 #include "Tools/Debugging/DebugDrawings.h"
 
-HoughTrans::HoughTrans(const Image& image) :
+HoughTrans::HoughTrans(const Image& image, unsigned threads) :
+  coarseStep(1),
   _image(image),
+  _edgeImage(0),
   _houghDepth(30), //-- Number of depth layer
   _depthOffset(8), //-- Depth starting point
   _depthRatio(2),  //-- Distance between each layer
-  _houghSpace(HoughSpace(0, 0, 0))
+  _coarseStepUsed(0),
+  _coarseFirstRadius(0),
+  _fineRadii(0),
+  _workers(threads > 1 ? new WorkerPool(threads) : 0)
+{
+  createOffsets();
+}
+
+HoughTrans::HoughTrans(const EdgeImage& edgeImage, unsigned threads) :
+  coarseStep(1),
+  _image(edgeImage),
+  _edgeImage(&edgeImage),
+  _houghDepth(30),
+  _depthOffset(8),
+  _depthRatio(2),
+  _coarseStepUsed(0),
+  _coarseFirstRadius(0),
+  _fineRadii(0),
+  _workers(threads > 1 ? new WorkerPool(threads) : 0)
 {
+  createOffsets();
 }
 
 HoughTrans::~HoughTrans()
 {
+  delete _workers;
 }
 
-void HoughTrans::update()
+void HoughTrans::createOffsets()
 {
+  _offsets.resize(_houghDepth);
+  _planePoints.resize(_houghDepth);
+  for (unsigned R=0; R<_houghDepth; ++R)
+  {
+    const int r = R*_depthRatio + _depthOffset;
+    //-- Drawing a circle with radius of `r'
+    for (int x=0; x<r; ++x)
+    {
+      const int y = sqrt(r*r - x*x);
+      //-- Each line below, draw one quarter
+      _offsets[R].push_back(Vector2i(x, y));
+      _offsets[R].push_back(Vector2i(-x, y));
+
+      //-- The bottom part of the ball is not important,
+      //-- since  it does not  have  a clear edge due to
+      //-- ground reflex on it:
+      //-- (x, -y) and (-x, -y)
+    }
+  }
+}
 
-  if (_houghSpace.width() < _image.width || _houghSpace.height() < _image.height)
+void HoughTrans::update()
+{
+  if ((int)_houghSpace.width() < _image.width || (int)_houghSpace.height() < _image.height)
+  {
     _houghSpace.resize(_image.width, _image.height, _houghDepth);
 
-  _houghSpace.clean();
-  calculateHough();
-  extractPoints();
+    _linearOffsets.resize(_houghDepth);
+    for (unsigned R=0; R<_houghDepth; ++R)
+    {
+      _linearOffsets[R].clear();
+      for (const Vector2i& o : _offsets[R])
+        _linearOffsets[R].push_back(o.y*(int)_houghSpace.width() + o.x);
+    }
+  }
+
+  collectEdges();
+
+  if (coarseStep > 1)
+  {
+    const unsigned coarseWidth = (_houghSpace.width() + coarseStep - 1) / coarseStep;
+    const unsigned coarseHeight = (_houghSpace.height() + coarseStep - 1) / coarseStep;
+    if (_coarseSpace.width() != coarseWidth || _coarseSpace.height() != coarseHeight || _coarseStepUsed != coarseStep)
+      createCoarseOffsets();
+    if (_edgeMap.size() != _houghSpace.width()*_houghSpace.height())
+      _edgeMap.assign(_houghSpace.width()*_houghSpace.height(), 0);
+
+    //-- The downsampled edge map, each block with an edge once
+    _coarseEdges.clear();
+    for (const Vector2i& p : _edges)
+    {
+      _edgeMap[p.y*_houghSpace.width() + p.x] = 1;
+      unsigned char& coarse = _coarseEdgeMap[(p.y / coarseStep)*coarseWidth + p.x / coarseStep];
+      if (!coarse)
+      {
+        coarse = 1;
+        _coarseEdges.push_back(Vector2i(p.x / coarseStep, p.y / coarseStep));
+      }
+    }
+
+    //-- The peaks of the neighbouring coarse radii are needed for refining one,
+    //-- so all of them are voted before the first one is refined. The radii
+    //-- below the coarse ones are searched at full resolution meanwhile.
+    const unsigned planes = _coarseSpace.depth();
+    const WorkerPool::Job coarsePlane = [this, planes](unsigned job, unsigned)
+    {
+      if (job >= planes)
+      {
+        const unsigned R = job - planes;
+        _houghSpace.clean(R);
+        vote(_houghSpace, R, R*_depthRatio + _depthOffset, _edges, _offsets[R], _linearOffsets[R]);
+        extractPoints(R);
+        return;
+      }
+      const unsigned k = planes - 1 - job;
+      _coarseSpace.clean(k);
+      vote(_coarseSpace, k, k + _coarseFirstRadius, _coarseEdges, _coarseOffsets[k], _coarseLinearOffsets[k]);
+      findCoarsePeaks(k);
+    };
+    const WorkerPool::Job refinePlane = [this, planes](unsigned job, unsigned)
+    {
+      refineCoarsePeaks(planes - 1 - job);
+    };
+    if (_workers)
+    {
+      _workers->run(planes + _fineRadii, coarsePlane);
+      _workers->run(planes, refinePlane);
+    }
+    else
+    {
+      for (unsigned job=0; job<planes + _fineRadii; ++job)
+        coarsePlane(job, 0);
+      for (unsigned job=0; job<planes; ++job)
+        refinePlane(job, 0);
+    }
+
+    for (const Vector2i& p : _edges)
+      _edgeMap[p.y*_houghSpace.width() + p.x] = 0;
+    for (const Vector2i& p : _coarseEdges)
+      _coarseEdgeMap[p.y*coarseWidth + p.x] = 0;
+
+    mergePoints();
+    return;
+  }
+
+  //-- Every plane is cleaned, voted and searched on its own, so
+  //-- the workers never touch the same counters
+  const WorkerPool::Job plane = [this](unsigned job, unsigned)
+  {
+    //-- Larger radii have more offsets, they are handed out first
+    const unsigned R = _houghDepth - 1 - job;
+    _houghSpace.clean(R);
+    vote(_houghSpace, R, R*_depthRatio + _depthOffset, _edges, _offsets[R], _linearOffsets[R]);
+    extractPoints(R);
+  };
+  if (_workers)
+    _workers->run(_houghDepth, plane);
+  else
+    for (unsigned job=0; job<_houghDepth; ++job)
+      plane(job, 0);
+
+  mergePoints();
+}
+
+void HoughTrans::collectEdges()
+{
+  _edges.clear();
+
+  if (_edgeImage)
+  {
+    //-- Points found by refining are marked with 127, which do not count as edge here
+    for (const Vector2i& p : _edgeImage->edgePoints())
+      if (_image[p.y][p.x].y > 127)
+        _edges.push_back(p);
+    return;
+  }
+
+  for (int cy=0; cy<_image.height; ++cy)
+    for (int cx=0; cx<_image.width; ++cx)
+      if (_image[cy][cx].y > 127)
+        _edges.push_back(Vector2i(cx, cy));
+}
+
+unsigned HoughTrans::minimumVotes(int r) const
+{
+  const double max = 1.85;
+
+  //-- Smallest count with count / r > max
+  unsigned minCount = max * r;
+  while ((double)minCount/r <= max)
+    ++minCount;
+  return minCount;
 }
 
-void HoughTrans::extractPoints()
+void HoughTrans::extractPoints(unsigned R)
+{
+  std::vector<Vector4i>& points = _planePoints[R];
+  points.clear();
+
+  const int width = _houghSpace.width();
+  const int r = R*_depthRatio + _depthOffset;
+  const unsigned minCount = minimumVotes(r);
+
+  const HoughSpace::HoughPixel* plane = _houghSpace.plane(R);
+  for (int cy=_houghSpace.minY(R); cy<=_houghSpace.maxY(R); ++cy)
+    for (int cx=0; cx<width; ++cx)
+    {
+      const HoughSpace::HoughPixel count = plane[cy*width + cx];
+      if (count >= minCount)
+        points.push_back(Vector4i(cx, cy, r, (double)count/r));
+    }
+}
+
+void HoughTrans::mergePoints()
 {
   _extPoints.clear();
+  for (const std::vector<Vector4i>& points : _planePoints)
+    _extPoints.insert(_extPoints.end(), points.begin(), points.end());
 
-  double max = 1.85;
-  unsigned px=0, py=0, pr=0;
-  for (unsigned cx=0; cx<_houghSpace.width(); ++cx)
-    for (unsigned cy=0; cy<_houghSpace.height(); ++cy)
-      for (unsigned R=0; R<_houghDepth; ++R)
-      {
-        const double r = R*_depthRatio + _depthOffset;
-        const double s = (double)_houghSpace(cx, cy, R)/r;
+  //-- The same order as scanning (cx, cy, r) in the space
+  std::sort(_extPoints.begin(), _extPoints.end(), [](const Vector4i& a, const Vector4i& b)
+  {
+    if (a[0] != b[0])
+      return a[0] < b[0];
+    if (a[1] != b[1])
+      return a[1] < b[1];
+    return a[2] < b[2];
+  });
+}
 
-        if (s > max)
-        {
-          // max = s;
-          px = cx; py = cy; pr = r;
-          _extPoints.push_back(Vector4i(px, py, pr, s));
-        }
+void HoughTrans::vote(HoughSpace& space, unsigned k, int r, const std::vector<Vector2i>& edges,
+                      const std::vector<Vector2i>& offsets, const std::vector<int>& linearOffsets)
+{
+  //-- Calculate one radius of the Hough Space, its plane stays in the cache
+  const int width = space.width();
+  const int height = space.height();
+  HoughSpace::HoughPixel* plane = space.plane(k);
+
+  for (const Vector2i& p : edges)
+  {
+    if (p.y >= height)
+      continue;
+    space.touch(k, p.y, std::min(p.y + r, height - 1));
+
+    if (p.x >= r && p.x + r < width && p.y + r < height)
+    {
+      HoughSpace::HoughPixel* center = plane + p.y*width + p.x;
+      for (const int o : linearOffsets)
+        center[o]++;
+    }
+    else
+    {
+      for (const Vector2i& o : offsets)
+      {
+        const int x = p.x + o.x;
+        const int y = p.y + o.y;
+        if (x >= 0 && x < width && y < height)
+          plane[y*width + x]++;
       }
+    }
+  }
+}
+
+void HoughTrans::createCoarseOffsets()
+{
+  const unsigned coarseWidth = (_houghSpace.width() + coarseStep - 1) / coarseStep;
+  const unsigned coarseHeight = (_houghSpace.height() + coarseStep - 1) / coarseStep;
+  _coarseStepUsed = coarseStep;
+  _coarseFirstRadius = std::max(coarseRadius(0), (unsigned)PYRAMID_MIN_RADIUS);
+  _fineRadii = 0;
+  while (_fineRadii < _houghDepth && coarseRadius(_fineRadii) < _coarseFirstRadius)
+    ++_fineRadii;
+  const unsigned planes = _fineRadii < _houghDepth ? coarseRadius(_houghDepth - 1) - _coarseFirstRadius + 1 : 0;
+  _coarseSpace.resize(coarseWidth, coarseHeight, planes);
+  _coarseEdgeMap.assign(coarseWidth*coarseHeight, 0);
+  _coarseMarks.assign(coarseWidth*coarseHeight*planes, 0);
+  _coarsePeaks.resize(planes);
+  _markedBlocks.resize(planes);
 
+  //-- The same half circles as the full resolution ones, with the coarse radii
+  _coarseOffsets.assign(planes, std::vector<Vector2i>());
+  _coarseLinearOffsets.assign(planes, std::vector<int>());
+  for (unsigned k=0; k<planes; ++k)
+  {
+    const int r = k + _coarseFirstRadius;
+    for (int x=0; x<r; ++x)
+    {
+      const int y = sqrt(r*r - x*x);
+      _coarseOffsets[k].push_back(Vector2i(x, y));
+      _coarseOffsets[k].push_back(Vector2i(-x, y));
+    }
+    for (const Vector2i& o : _coarseOffsets[k])
+      _coarseLinearOffsets[k].push_back(o.y*(int)coarseWidth + o.x);
+  }
 }
 
-void HoughTrans::calculateHough()
+void HoughTrans::findCoarsePeaks(unsigned k)
 {
-  //-- Calculate Hough Space;
-  for (unsigned cx=0; cx<_image.width; ++cx)
-    for (unsigned cy=0; cy<_image.height; ++cy)
-      if (_image[cy][cx].y > 127)
-        for (unsigned R=0; R<_houghDepth; ++R)
-        {
-          const int r = R*_depthRatio + _depthOffset;
-          //-- Drawing a circle with radius of `r'
-          for (int x=0; x<r; ++x)
+  //-- A downsampled outline loses some votes to the rounding, so the coarse threshold is lower
+  const int coarseWidth = _coarseSpace.width();
+  const unsigned minCount = std::max(1u, (unsigned)(PYRAMID_COARSE_SHARE * minimumVotes(k + _coarseFirstRadius)));
+  const HoughSpace::HoughPixel* plane = _coarseSpace.plane(k);
+
+  std::vector<int>& peaks = _coarsePeaks[k];
+  peaks.clear();
+  for (int by=_coarseSpace.minY(k); by<=_coarseSpace.maxY(k); ++by)
+    for (int bx=0; bx<coarseWidth; ++bx)
+      if (plane[by*coarseWidth + bx] >= minCount)
+        peaks.push_back(by*coarseWidth + bx);
+}
+
+void HoughTrans::refineCoarsePeaks(unsigned k)
+{
+  const int width = _houghSpace.width();
+  const int height = _houghSpace.height();
+  const int coarseWidth = _coarseSpace.width();
+  const int coarseHeight = _coarseSpace.height();
+  const int step = coarseStep;
+
+  //-- The radii of the full resolution counted in this plane
+  unsigned first = _fineRadii;
+  while (coarseRadius(first) < k + _coarseFirstRadius)
+    ++first;
+  unsigned last = first;
+  while (last < _houghDepth && coarseRadius(last) == k + _coarseFirstRadius)
+    ++last;
+  for (unsigned R=first; R<last; ++R)
+    _planePoints[R].clear();
+
+  //-- Blocks next to a peak of this or a neighbouring coarse radius, as the peak of
+  //-- a circle may fall into the block next to its center or into the radius next to it
+  unsigned char* marks = &_coarseMarks[k*coarseWidth*coarseHeight];
+  std::vector<int>& marked = _markedBlocks[k];
+  marked.clear();
+  for (unsigned j=(k ? k-1 : 0); j<=std::min(k+1, _coarseSpace.depth()-1); ++j)
+    for (const int peak : _coarsePeaks[j])
+    {
+      const int px = peak % coarseWidth;
+      const int py = peak / coarseWidth;
+      for (int by=std::max(py-1, 0); by<=std::min(py+1, coarseHeight-1); ++by)
+        for (int bx=std::max(px-1, 0); bx<=std::min(px+1, coarseWidth-1); ++bx)
+          if (!marks[by*coarseWidth + bx])
           {
-            const int y = sqrt(r*r - x*x);
-            //-- Each line below, draw one quarter
-            increase(cx + x, cy + y, R);
-            increase(cx - x, cy + y, R);
-
-            //-- The bottom part of the ball is not important,
-            //-- since  it does not  have  a clear edge due to
-            //-- ground reflex on it:
-            //-- increase(cx + x, cy - y, R);
-            //-- increase(cx - x, cy - y, R);
+            marks[by*coarseWidth + bx] = 1;
+            marked.push_back(by*coarseWidth + bx);
           }
+    }
+
+  //-- Only the centers of the marked blocks are counted at full resolution,
+  //-- each of them belongs to one block, so none is counted twice
+  for (const int block : marked)
+  {
+    marks[block] = 0;
+    const int bx = block % coarseWidth;
+    const int by = block / coarseWidth;
+    for (unsigned R=first; R<last; ++R)
+    {
+      const int r = R*_depthRatio + _depthOffset;
+      const unsigned minCount = minimumVotes(r);
+      for (int cy=by*step; cy<std::min((by+1)*step, height); ++cy)
+        for (int cx=bx*step; cx<std::min((bx+1)*step, width); ++cx)
+        {
+          const unsigned count = countVotes(cx, cy, R);
+          if (count >= minCount)
+            _planePoints[R].push_back(Vector4i(cx, cy, r, (double)count/r));
         }
+    }
+  }
 }
 
-inline void HoughTrans::increase(unsigned x, unsigned y, unsigned z)
+unsigned HoughTrans::countVotes(int x, int y, unsigned R) const
 {
-  if (x >= 0 && x < _houghSpace.width() && y >= 0 && y < _houghSpace.height() && z >= 0 && z < _houghSpace.depth())
-    _houghSpace(x, y, z)++;
+  //-- The edges which would vote for this center
+  const int width = _houghSpace.width();
+  const int height = _houghSpace.height();
+  const int r = R*_depthRatio + _depthOffset;
+  unsigned count = 0;
+  if (x >= r && x + r < width && y >= r && y < height)
+  {
+    const unsigned char* center = &_edgeMap[y*width + x];
+    for (const int o : _linearOffsets[R])
+      count += center[-o];
+    return count;
+  }
+
+  for (const Vector2i& o : _offsets[R])
+  {
+    const int ex = x - o.x;
+    const int ey = y - o.y;
+    if (ex >= 0 && ex < width && ey >= 0 && ey < height)
+      count += _edgeMap[ey*width + ex];
+  }
+  return count;
 }
 
-HoughTrans::HoughSpace::HoughSpace(unsigned width, unsigned height, unsigned depth) :
-		    _width(width),
-		    _height(height),
-		    _depth(depth)
+HoughTrans::HoughSpace::HoughSpace() :
+  _width(0),
+  _height(0),
+  _depth(0)
 {
-  resize(width, height, depth);
-  clean();
 }
 
 inline const HoughTrans::HoughSpace::HoughPixel& HoughTrans::HoughSpace::operator () (unsigned i, unsigned j, unsigned k) const
 {
   if (!(i < _width && j < _height && k < _depth))
     throw ("out of range matrix usage...\n");
-  return _space[j*_width*_depth + i*_depth + k];
+  return _space[(k*_height + j)*_width + i];
 }
 
 inline HoughTrans::HoughSpace::HoughPixel& HoughTrans::HoughSpace::operator () (unsigned i, unsigned j, unsigned k)
 {
   if (!(i < _width && j < _height && k < _depth))
     throw ("out of range matrix usage...\n");
-  return _space[j*_width*_depth + i*_depth + k];
+  return _space[(k*_height + j)*_width + i];
 }
 
 void HoughTrans::HoughSpace::resize(unsigned width, unsigned height, unsigned depth)
 {
-  if (_space)
-    delete _space;
-
   _width = width;
   _height = height;
   _depth = depth;
 
-  _size = _width*_height*_depth;
-  _space = new HoughPixel[_size];
+  _space.assign(_width*_height*_depth, 0);
+  _minY.assign(_depth, _height);
+  _maxY.assign(_depth, -1);
 }
 
 void HoughTrans::HoughSpace::clean()
 {
-  for (unsigned i=0; i<_size; ++i)
-    _space[i] = 0;
+  for (unsigned k=0; k<_depth; ++k)
+    clean(k);
+}
+
+void HoughTrans::HoughSpace::clean(unsigned k)
+{
+  //-- Only the rows which got votes
+  if (_minY[k] <= _maxY[k])
+    std::fill(plane(k) + _minY[k]*_width, plane(k) + (_maxY[k]+1)*_width, 0);
+  _minY[k] = _height;
+  _maxY[k] = -1;
 }
 
 HoughTrans::HoughSpace::~HoughSpace()
 {
-  delete _space;
 }
@@ -10,21 +10,25 @@
 
 #include "Representations/Infrastructure/Image.h"
 #include "Tools/Math/Vector.h"
+#include "EdgeImage.h"
+#include "WorkerPool.h"
 #include <vector>
 
 class HoughTrans
 {
+  //-- One plane of width x height counters per radius
   class HoughSpace
   {
   public:
-    typedef unsigned long HoughPixel;
+    typedef unsigned short HoughPixel; //-- A cell gets at most one vote per offset of its radius, far below 2^16
 
-    HoughSpace(unsigned width, unsigned height, unsigned depth);
+    HoughSpace();
     ~HoughSpace();
     void clean();
+    void clean(unsigned k);
     void resize(unsigned width, unsigned height, unsigned depth);
 
-    inline unsigned size() const { return _size; }
+    inline unsigned size() const { return _space.size(); }
     inline unsigned width() const { return _width; }
     inline unsigned height() const { return _height; }
     inline unsigned depth() const { return _depth; }
@@ -32,29 +36,76 @@ class HoughTrans
     inline const HoughPixel& operator () (unsigned i, unsigned j, unsigned k) const;
     inline HoughPixel& operator () (unsigned i, unsigned j, unsigned k);
 
+    inline HoughPixel* plane(unsigned k) { return &_space[k*_width*_height]; }
+    inline const HoughPixel* plane(unsigned k) const { return &_space[k*_width*_height]; }
+
+    //-- Rows [minY, maxY] of plane k are about to get votes
+    inline void touch(unsigned k, int minY, int maxY)
+    {
+      if (minY < _minY[k]) _minY[k] = minY;
+      if (maxY > _maxY[k]) _maxY[k] = maxY;
+    }
+    inline int minY(unsigned k) const { return _minY[k]; }
+    inline int maxY(unsigned k) const { return _maxY[k]; }
+
   private:
     unsigned _width, _height, _depth;
-    unsigned _size;
-    HoughPixel* _space;
+    std::vector<HoughPixel> _space;
+    std::vector<int> _minY, _maxY; //-- Rows of each plane with votes since the last clean
   };
 
 public:
-  HoughTrans(const Image& image);
+  //-- With more than one thread, the radius planes are shared among a pool of workers
+  HoughTrans(const Image& image, unsigned threads = 1);         //-- Votes for every pixel of the image brighter than 127
+  HoughTrans(const EdgeImage& edgeImage, unsigned threads = 1); //-- Votes only for the edge points found by the edge image
   ~HoughTrans();
 
   void update();
   const std::vector<Vector4i>& extractedPoints() const { return _extPoints; }
 
+  //-- With 2 or 4 the edges are first downsampled by coarseStep and voted with the radii divided
+  //-- by it. Only the centers in the blocks around the coarse peaks are then counted at full
+  //-- resolution, with the radii of the coarse radius of the peak and of its neighbours. Radii
+  //-- which would be below PYRAMID_MIN_RADIUS coarse pixels are searched at full resolution.
+  unsigned coarseStep;
+
 private:
   const Image& _image;
+  const EdgeImage* _edgeImage;
   unsigned _houghDepth;
   unsigned _depthOffset;
   unsigned _depthRatio;
   HoughSpace _houghSpace;
+  HoughSpace _coarseSpace;     //-- One plane per coarse radius, one counter per block
+  unsigned _coarseStepUsed;    //-- The coarseStep the coarse space was made for
+  unsigned _coarseFirstRadius; //-- Of the first plane of the coarse space
+  unsigned _fineRadii;         //-- The radii below it, searched at full resolution
+  std::vector<std::vector<Vector2i> > _coarseOffsets; //-- Half circle of each coarse radius
+  std::vector<std::vector<int> > _coarseLinearOffsets;
+  std::vector<Vector2i> _coarseEdges;           //-- Blocks with an edge
+  std::vector<unsigned char> _coarseEdgeMap;
+  std::vector<std::vector<int> > _coarsePeaks;  //-- Blocks of each plane reaching the coarse threshold
+  std::vector<unsigned char> _coarseMarks;      //-- Blocks of each plane to count at full resolution
+  std::vector<std::vector<int> > _markedBlocks;
+  std::vector<unsigned char> _edgeMap; //-- Edges marked in the size of the hough space, for counting single centers
   std::vector<Vector4i> _extPoints;
+  std::vector<std::vector<Vector4i> > _planePoints; //-- Extracted points of each radius, merged into _extPoints
+  std::vector<Vector2i> _edges;
+  std::vector<std::vector<Vector2i> > _offsets; //-- Half circle of each radius, the voting pattern
+  std::vector<std::vector<int> > _linearOffsets; //-- The same as offsets into a plane
+  WorkerPool* _workers;
 
-  void calculateHough();
-  void extractPoints();
-  inline void increase(unsigned x, unsigned y, unsigned z);
+  void createOffsets();
+  void collectEdges();
+  void vote(HoughSpace& space, unsigned k, int r, const std::vector<Vector2i>& edges,
+            const std::vector<Vector2i>& offsets, const std::vector<int>& linearOffsets);
+  void extractPoints(unsigned R);
+  void mergePoints();
+  void createCoarseOffsets();
+  void findCoarsePeaks(unsigned k);
+  void refineCoarsePeaks(unsigned k);
+  unsigned countVotes(int x, int y, unsigned R) const;
+  unsigned minimumVotes(int r) const;
+  inline unsigned coarseRadius(unsigned R) const { return (R*_depthRatio + _depthOffset + coarseStep/2) / coarseStep; }
 };
 
@@ -0,0 +1,206 @@
+/**
+ * @file Instrumentation.cpp
+ * Scoped timers and counters of the ball pipeline
+ * @author <a href="mailto:agent@local">agent</a>
+ * @date Oct 2026
+ */
+
+#include "Instrumentation.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+static unsigned threadIndex()
+{
+  static std::atomic<unsigned> threads(0);
+  static thread_local unsigned index = threads++;
+  return index;
+}
+
+Instrumentation& Instrumentation::get()
+{
+  static Instrumentation instrumentation;
+  return instrumentation;
+}
+
+unsigned long long Instrumentation::now()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+Instrumentation::Instrumentation() :
+  _head(0)
+{
+  for (Channel& c : _channels)
+  {
+    c.name = 0;
+    c.calls = c.value = c.frameCalls = c.frameValue = 0;
+    c.lastFrameCalls = c.lastFrameValue = 0;
+    for (std::atomic<unsigned>& b : c.histogram)
+      b = 0;
+  }
+  for (Slot& e : _events)
+  {
+    e.sequence = 0;
+    e.name = 0;
+    e.start = e.duration = 0;
+    e.thread = 0;
+    e.counter = false;
+  }
+}
+
+Instrumentation::Channel* Instrumentation::find(const char* name)
+{
+  //-- Mostly the literal the channel was taken with, comparing the addresses is enough
+  for (Channel& c : _channels)
+  {
+    const char* n = c.name.load(std::memory_order_acquire);
+    if (n == name)
+      return &c;
+    if (!n)
+      break;
+  }
+
+  for (Channel& c : _channels)
+  {
+    //-- The same literal may have another address in another file
+    const char* n = c.name.load(std::memory_order_acquire);
+    if (n && !strcmp(n, name))
+      return &c;
+
+    //-- Taking the free channel, unless another thread took it for another name meanwhile
+    if (!n && (c.name.compare_exchange_strong(n, name) || !strcmp(n, name)))
+      return &c;
+  }
+  return 0;
+}
+
+void Instrumentation::push(const char* name, unsigned long long start, unsigned long long duration, bool counter)
+{
+  const unsigned long long number = _head.fetch_add(1, std::memory_order_relaxed);
+  Slot& e = _events[number & (INSTRUMENTATION_EVENTS - 1)];
+
+  //-- Only over a complete older event. After a wraparound another thread may still be writing
+  //-- this slot, or may have written a newer event there already, the event is dropped then.
+  unsigned long long sequence = e.sequence.load(std::memory_order_relaxed);
+  do
+    if ((sequence & 1) || sequence > 2 * number)
+      return;
+  while (!e.sequence.compare_exchange_weak(sequence, 2 * number + 1, std::memory_order_acquire, std::memory_order_relaxed));
+
+  e.name.store(name, std::memory_order_relaxed);
+  e.start.store(start, std::memory_order_relaxed);
+  e.duration.store(duration, std::memory_order_relaxed);
+  e.thread.store(threadIndex(), std::memory_order_relaxed);
+  e.counter.store(counter, std::memory_order_relaxed);
+  e.sequence.store(2 * (number + 1), std::memory_order_release);
+}
+
+bool Instrumentation::event(unsigned long long number, Event& event) const
+{
+  const Slot& e = _events[number & (INSTRUMENTATION_EVENTS - 1)];
+  const unsigned long long sequence = e.sequence.load(std::memory_order_acquire);
+  if (sequence != 2 * (number + 1))
+    return false;
+
+  event.name = e.name.load(std::memory_order_relaxed);
+  event.start = e.start.load(std::memory_order_relaxed);
+  event.duration = e.duration.load(std::memory_order_relaxed);
+  event.thread = e.thread.load(std::memory_order_relaxed);
+  event.counter = e.counter.load(std::memory_order_relaxed);
+
+  //-- Not overwritten while it was copied
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return e.sequence.load(std::memory_order_relaxed) == sequence;
+}
+
+void Instrumentation::record(const char* name, unsigned long long start, unsigned long long duration)
+{
+  Channel* c = find(name);
+  if (!c)
+    return;
+
+  int bucket = 0;
+  while (bucket < INSTRUMENTATION_BUCKETS - 1 && duration >> (bucket + 1))
+    ++bucket;
+  c->histogram[bucket].fetch_add(1, std::memory_order_relaxed);
+  c->calls.fetch_add(1, std::memory_order_relaxed);
+  c->frameCalls.fetch_add(1, std::memory_order_relaxed);
+  push(name, start, duration, false);
+}
+
+void Instrumentation::count(const char* name, unsigned long long value)
+{
+  Channel* c = find(name);
+  if (!c)
+    return;
+
+  c->value.fetch_add(value, std::memory_order_relaxed);
+  c->frameValue.fetch_add(value, std::memory_order_relaxed);
+}
+
+void Instrumentation::newFrame()
+{
+  const unsigned long long time = now();
+  for (Channel& c : _channels)
+  {
+    const char* name = c.name.load(std::memory_order_acquire);
+    if (!name)
+      break;
+
+    c.lastFrameCalls = c.frameCalls.exchange(0, std::memory_order_relaxed);
+    c.lastFrameValue = c.frameValue.exchange(0, std::memory_order_relaxed);
+    if (c.lastFrameValue)
+      push(name, time, c.lastFrameValue, true);
+  }
+}
+
+int Instrumentation::channels() const
+{
+  int count = 0;
+  while (count < INSTRUMENTATION_CHANNELS && _channels[count].name.load(std::memory_order_acquire))
+    ++count;
+  return count;
+}
+
+void Instrumentation::writeChromeTrace(std::ostream& stream) const
+{
+  //-- The oldest event kept first, times relative to it in microseconds
+  const unsigned long long head = _head.load(std::memory_order_acquire);
+  const unsigned long long first = head > INSTRUMENTATION_EVENTS ? head - INSTRUMENTATION_EVENTS : 0;
+  Event e;
+  unsigned long long origin = ~0ull;
+  for (unsigned long long i=first; i<head; ++i)
+    if (event(i, e))
+      origin = std::min(origin, e.start);
+
+  stream << "{\"traceEvents\":[";
+  bool separator = false;
+  for (unsigned long long i=first; i<head; ++i)
+  {
+    if (!event(i, e) || e.start < origin)
+      continue;
+    stream << (separator ? ",\n" : "\n") << "{\"name\":\"" << e.name << "\",\"pid\":0,\"tid\":" << e.thread
+           << ",\"ts\":" << (e.start - origin) / 1000.0;
+    if (e.counter)
+      stream << ",\"ph\":\"C\",\"args\":{\"value\":" << e.duration << "}}";
+    else
+      stream << ",\"ph\":\"X\",\"dur\":" << e.duration / 1000.0 << "}";
+    separator = true;
+  }
+  stream << "\n],\"displayTimeUnit\":\"ms\"}\n";
+}
+
+void Instrumentation::writeHistograms(std::ostream& stream) const
+{
+  for (int i=0; i<channels(); ++i)
+  {
+    const Channel& c = _channels[i];
+    stream << c.name.load() << ": " << c.calls.load() << " calls, " << c.value.load() << " counted";
+    for (int b=0; b<INSTRUMENTATION_BUCKETS; ++b)
+      if (c.histogram[b].load())
+        stream << ", <" << (2ull << b) / 1000.0 << "us: " << c.histogram[b].load();
+    stream << "\n";
+  }
+}
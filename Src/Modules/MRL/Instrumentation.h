@@ -0,0 +1,114 @@
+/**
+ * @file Instrumentation.h
+ * Scoped timers and counters of the ball pipeline, cheap enough for the
+ * innermost loops and usable from the worker threads. Each name gets a
+ * channel with its calls, its counted values and a latency histogram.
+ * Every timed scope also goes into a fixed ring of the last events, which
+ * can be written as a Chrome trace (chrome://tracing, `trace_event' JSON).
+ * Each slot of the ring is published with a sequence number, so an event is
+ * never read or written halfway. When the ring wraps around while a slot is
+ * still being written, the newer event is dropped.
+ * With RELEASE defined the macros below compile to nothing.
+ * @author <a href="mailto:agent@local">agent</a>
+ * @date Oct 2026
+ */
+
+#pragma once
+
+#include <atomic>
+#include <ostream>
+
+#define INSTRUMENTATION_CHANNELS 48  //-- Different names, later ones are dropped
+#define INSTRUMENTATION_EVENTS 16384 //-- Events kept for the trace, has to be a power of two
+#define INSTRUMENTATION_BUCKETS 32   //-- Histogram bucket b holds the durations in [2^b, 2^(b+1)) ns
+
+class Instrumentation
+{
+public:
+  class Channel
+  {
+  public:
+    std::atomic<const char*> name; //-- Has to be a string literal, 0 while the channel is free
+    std::atomic<unsigned long long> calls, value;           //-- Since the start
+    std::atomic<unsigned long long> frameCalls, frameValue; //-- Of the running frame
+    unsigned long long lastFrameCalls, lastFrameValue;      //-- Of the frame before
+    std::atomic<unsigned> histogram[INSTRUMENTATION_BUCKETS];
+  };
+
+  class Event
+  {
+  public:
+    const char* name;
+    unsigned long long start;    //-- ns
+    unsigned long long duration; //-- ns, or the value of a counter
+    unsigned thread;
+    bool counter;
+  };
+
+  //-- Copies the event with that number, false if it has been overwritten or is being written
+  bool event(unsigned long long number, Event& event) const;
+
+  class Scope
+  {
+  public:
+    Scope(const char* name) : name(name), start(now()) {}
+    ~Scope() { get().record(name, start, now() - start); }
+
+  private:
+    const char* name;
+    unsigned long long start;
+  };
+
+  static Instrumentation& get();
+  static unsigned long long now();
+
+  //-- Both may be called from any thread at once
+  void record(const char* name, unsigned long long start, unsigned long long duration);
+  void count(const char* name, unsigned long long value);
+
+  //-- Moves the frame values to lastFrameCalls / lastFrameValue and puts them into the trace as
+  //-- counters. This and the functions below must not run while anything is recorded.
+  void newFrame();
+
+  int channels() const;
+  const Channel& channel(int index) const { return _channels[index]; }
+
+  void writeChromeTrace(std::ostream& stream) const;
+  void writeHistograms(std::ostream& stream) const;
+
+private:
+  //-- An event in the ring. Its sequence is 2 * number + 1 while event `number' is being written and
+  //-- 2 * (number + 1) once it is complete.
+  class Slot
+  {
+  public:
+    std::atomic<unsigned long long> sequence;
+    std::atomic<const char*> name;
+    std::atomic<unsigned long long> start, duration;
+    std::atomic<unsigned> thread;
+    std::atomic<bool> counter;
+  };
+
+  Instrumentation();
+
+  Channel _channels[INSTRUMENTATION_CHANNELS];
+  Slot _events[INSTRUMENTATION_EVENTS];
+  std::atomic<unsigned long long> _head; //-- Events written so far, the ring keeps the last ones
+
+  Channel* find(const char* name);
+  void push(const char* name, unsigned long long start, unsigned long long duration, bool counter);
+};
+
+#ifndef RELEASE
+#define INSTRUMENT_JOIN2(a, b) a##b
+#define INSTRUMENT_JOIN(a, b) INSTRUMENT_JOIN2(a, b)
+#define INSTRUMENT_SCOPE(name) Instrumentation::Scope INSTRUMENT_JOIN(_instrumentationScope, __LINE__)(name)
+#define INSTRUMENT_COUNT(name, value) Instrumentation::get().count(name, value)
+#define INSTRUMENT_RECORD(name, start, duration) Instrumentation::get().record(name, start, duration) //-- Of a duration measured anyway
+#define INSTRUMENT_FRAME() Instrumentation::get().newFrame()
+#else
+#define INSTRUMENT_SCOPE(name) ((void) 0)
+#define INSTRUMENT_COUNT(name, value) ((void) 0)
+#define INSTRUMENT_RECORD(name, start, duration) ((void) 0)
+#define INSTRUMENT_FRAME() ((void) 0)
+#endif
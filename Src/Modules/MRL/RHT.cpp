@@ -8,10 +8,15 @@
 #include "RHT.h"
 #include <time.h>
 #include <algorithm>
+#include <climits>
 
 #include <iostream>
 #include "Tools/Debugging/DebugDrawings.h"
 
+#define RHT_RESULTS 11
+#define RHT_GRID_BUCKETS 1024 //-- Has to be a power of two
+#define GRID_NONE LLONG_MIN
+
 RHT::RHT(const Image& image) :
   _rhtSamples(5),
   _divisions(4),
@@ -21,6 +26,14 @@ RHT::RHT(const Image& image) :
 {
   // [TODO] : read this parameters from a config file
 
+  //-- Nothing has to grow during the frames, every sample adds at most one circle
+  _prospectiveCircles.reserve(_rhtSamples * _divisions*_divisions * _pointsEachSegment);
+  _extPoints.reserve(11);
+  _bucketStarts.reserve(_divisions*_divisions + 1);
+  _gridEntries.reserve(_prospectiveCircles.capacity());
+  _ranking.reserve(_prospectiveCircles.capacity());
+  _gridBuckets.resize(RHT_GRID_BUCKETS);
+
   srand(time(NULL));
 }
 
@@ -31,9 +44,11 @@ RHT::~RHT()
 void RHT::update()
 {
   _prospectiveCircles.clear();
+  _gridEntries.clear();
+  std::fill(_gridBuckets.begin(), _gridBuckets.end(), -1);
   extractEdgePoints();
 
-  for (unsigned i=0; i<_rhtSamples; ++i)
+  for (int i=0; i<_rhtSamples; ++i)
     selectRandomPoint();
 
   extractResults();
@@ -41,26 +56,39 @@ void RHT::update()
 
 void RHT::extractEdgePoints()
 {
-  _edges.clear();
-
   const int offsetX = _edgeImage.width/_divisions;
   const int offsetY = _edgeImage.height/_divisions;
+  const int buckets = _divisions*_divisions;
 
-  for (unsigned i=0; i<_divisions; ++i)
-    for (unsigned j=0; j<_divisions; ++j)
-    {
-      const int si = i*offsetX;
-      const int sj = j*offsetY;
+  _unsortedEdges.clear();
+  _keyStarts.assign(buckets*offsetX + 1, 0);
+  for (int y=0; y<offsetY*_divisions; ++y)
+  {
+    const int j = y / offsetY;
+    for (int x=0; x<offsetX*_divisions; ++x)
+      if (_edgeImage[y][x].y > 127)
+      {
+        const int i = x / offsetX;
+        _keyStarts[(i*_divisions + j)*offsetX + x - i*offsetX + 1]++;
+        _unsortedEdges.push_back(EdgePoint{(short)x, (short)y});
+      }
+  }
 
-      std::vector<Vector2i> subImage;
+  for (int k=1; k<(int)_keyStarts.size(); ++k)
+    _keyStarts[k] += _keyStarts[k-1];
 
-      for (int x=si; x<si+offsetX; ++x)
-        for (int y=sj; y<sj+offsetY; ++y)
-          if (_edgeImage[y][x].y > 127)
-            subImage.push_back(Vector2i(x, y));
+  _bucketStarts.clear();
+  for (int b=0; b<=buckets; ++b)
+    _bucketStarts.push_back(_keyStarts[b*offsetX]);
 
-      _edges.push_back(subImage);
-    }
+  //-- Stable, so the points of a key stay ordered by y
+  _edges.resize(_unsortedEdges.size());
+  for (const EdgePoint& p : _unsortedEdges)
+  {
+    const int i = p.x / offsetX;
+    const int j = p.y / offsetY;
+    _edges[_keyStarts[(i*_divisions + j)*offsetX + p.x - i*offsetX]++] = p;
+  }
 }
 
 void RHT::selectRandomPoint()
@@ -69,18 +97,20 @@ void RHT::selectRandomPoint()
   //-- in order to  increase the chance of selecting random
   //-- point from a circle. This trick had a really incredible
   //-- impact on the algorithm.
-  for (std::vector<Vector2i> subImage : _edges)
+  for (int b=0; b+1<(int)_bucketStarts.size(); ++b)
   {
-    if (!subImage.size())
+    const EdgePoint* subImage = _edges.data() + _bucketStarts[b];
+    const int size = _bucketStarts[b+1] - _bucketStarts[b];
+    if (!size)
       continue;
 
-    for (unsigned itr=0; itr<_pointsEachSegment; ++itr)
+    for (int itr=0; itr<_pointsEachSegment; ++itr)
     {
-      const Vector2i& p1 = subImage[rand() % subImage.size()];
-      const Vector2i& p2 = subImage[rand() % subImage.size()];
-      const Vector2i& p3 = subImage[rand() % subImage.size()];
+      const EdgePoint& p1 = subImage[rand() % size];
+      const EdgePoint& p2 = subImage[rand() % size];
+      const EdgePoint& p3 = subImage[rand() % size];
 
-      houghTransform(p1, p2, p3);
+      houghTransform(Vector2i(p1.x, p1.y), Vector2i(p2.x, p2.y), Vector2i(p3.x, p3.y));
     }
   }
 }
@@ -117,24 +147,92 @@ inline void RHT::incriment(int x, int y, int& weight)
       weight++;
 }
 
+long long RHT::gridKey(const Vector3f& circle, int dx, int dy, int dr) const
+{
+  //-- Cells are at least as large as the merging distances, so a match is always in a neighbour cell
+  const float cellSize = std::ceil(std::sqrt(_selectingSigma));
+  const float radiusCellSize = std::ceil(_selectingSigma);
+
+  //-- Clamping keeps neighbours neighbours, circles far outside only share a few cells
+  const float limit = 1 << 19;
+  const long long qx = (long long)std::max(-limit, std::min(limit, std::floor(circle.x / cellSize))) + dx;
+  const long long qy = (long long)std::max(-limit, std::min(limit, std::floor(circle.y / cellSize))) + dy;
+  const long long qr = (long long)std::max(-limit, std::min(limit, std::floor(circle.z / radiusCellSize))) + dr;
+  return ((qx + (1 << 20)) << 42) | ((qy + (1 << 20)) << 21) | (qr + (1 << 20));
+}
+
+static inline int gridBucket(long long key)
+{
+  return (int)(((unsigned long long)key * 0x9E3779B97F4A7C15ull) >> 54) & (RHT_GRID_BUCKETS - 1);
+}
+
+void RHT::linkToGrid(int index)
+{
+  GridEntry& entry = _gridEntries[index];
+  if (entry.key == GRID_NONE)
+    return;
+  int& head = _gridBuckets[gridBucket(entry.key)];
+  entry.next = head;
+  head = index;
+}
+
+void RHT::unlinkFromGrid(int index)
+{
+  const GridEntry& entry = _gridEntries[index];
+  if (entry.key == GRID_NONE)
+    return;
+  int* link = &_gridBuckets[gridBucket(entry.key)];
+  while (*link != index)
+    link = &_gridEntries[*link].next;
+  *link = entry.next;
+}
+
 void RHT::addCircle(const Vector3f& cirlce, int weight)
 {
   const float radius = cirlce.z;
 
-  for (Vector4f& s : _prospectiveCircles)
+  //-- The first prospective circle close enough, as if all of them were checked in order
+  int match = -1;
+  const bool finite = std::isfinite(cirlce.x) && std::isfinite(cirlce.y) && std::isfinite(radius);
+  for (int dx=-1; dx<=1 && finite; ++dx)
+    for (int dy=-1; dy<=1; ++dy)
+      for (int dr=-1; dr<=1; ++dr)
+      {
+        const long long key = gridKey(cirlce, dx, dy, dr);
+        for (int i=_gridBuckets[gridBucket(key)]; i>=0; i=_gridEntries[i].next)
+        {
+          if (_gridEntries[i].key != key || (match >= 0 && i > match))
+            continue;
+
+          const Vector4f& s = _prospectiveCircles[i];
+          if ((Vector2f(cirlce.x, cirlce.y) - Vector2f(s.v[0], s.v[1])).sqr() < _selectingSigma &&
+              abs(radius - s[2]) < _selectingSigma)
+            match = i;
+        }
+      }
+
+  if (match >= 0)
   {
-    if ((Vector2f(cirlce.x, cirlce.y) - Vector2f(s.v[0], s.v[1])).sqr() < _selectingSigma &&
-        abs(radius - s[2]) < _selectingSigma)
+    Vector4f& s = _prospectiveCircles[match];
+    const float sWeight = s.v[3];
+    s = Vector4f(
+          (s.v[0]*sWeight + cirlce.x*weight) / (sWeight+weight), //-- update x
+          (s.v[1]*sWeight + cirlce.y*weight) / (sWeight+weight), //-- update y
+          (s.v[2]*sWeight + cirlce.z*weight) / (sWeight+weight), //-- update r
+          sWeight+weight                                         //-- update weight
+        );
+
+    //-- The mean may have moved to another cell
+    const Vector3f moved(s.v[0], s.v[1], s.v[2]);
+    const long long key = std::isfinite(moved.x) && std::isfinite(moved.y) && std::isfinite(moved.z) ?
+                          gridKey(moved, 0, 0, 0) : GRID_NONE;
+    if (key != _gridEntries[match].key)
     {
-      const float sWeight = s.v[3];
-      s = Vector4f(
-            (s.v[0]*sWeight + cirlce.x*weight) / (sWeight+weight), //-- update x
-            (s.v[1]*sWeight + cirlce.y*weight) / (sWeight+weight), //-- update y
-            (s.v[2]*sWeight + cirlce.z*weight) / (sWeight+weight), //-- update r
-            sWeight+weight                                         //-- update weight
-          );
-      return;
+      unlinkFromGrid(match);
+      _gridEntries[match].key = key;
+      linkToGrid(match);
     }
+    return;
   }
 
   _prospectiveCircles.push_back(Vector4f(
@@ -143,30 +241,33 @@ void RHT::addCircle(const Vector3f& cirlce, int weight)
       cirlce.z,
       weight
       ));
-}
 
-//-- This function had to be defined in the global space.
-bool circleSearchFunction(const Vector4f& a, const Vector4f b)
-{
-  return (a.v[3] > b.v[3]);
+  //-- Not a number can not be close to anything
+  _gridEntries.push_back(GridEntry{finite ? gridKey(cirlce, 0, 0, 0) : GRID_NONE, -1});
+  linkToGrid(_gridEntries.size() - 1);
 }
 
 void RHT::extractResults()
 {
   _extPoints.clear();
 
-  // [TODO] :
-  // Instead of  sorting, I think it worse it to check if it is better
-  // to push circles into _prospectiveCircles in uprising order at the
-  // first point.
-  std::sort(_prospectiveCircles.begin(), _prospectiveCircles.end(), circleSearchFunction);
+  //-- Only the best RHT_RESULTS are needed, ties in the order they were found
+  _ranking.resize(_prospectiveCircles.size());
+  for (unsigned i=0; i<_ranking.size(); ++i)
+    _ranking[i] = i;
 
-  for (const Vector4f& s : _prospectiveCircles)
+  // [FIXME] : this policy is completely wrong, since it does not guaranty the optimum result
+  const unsigned count = std::min<unsigned>(RHT_RESULTS, _ranking.size());
+  std::partial_sort(_ranking.begin(), _ranking.begin() + count, _ranking.end(), [this](int a, int b)
   {
-    _extPoints.push_back(Vector3f(s.v[0], s.v[1], s.v[2]));
+    const float weightA = _prospectiveCircles[a].v[3];
+    const float weightB = _prospectiveCircles[b].v[3];
+    return weightA != weightB ? weightA > weightB : a < b;
+  });
 
-    // [FIXME] : this policy is completely wrong, since it does not guaranty the optimum result
-    if (_extPoints.size() > 10)
-      return;
+  for (unsigned i=0; i<count; ++i)
+  {
+    const Vector4f& s = _prospectiveCircles[_ranking[i]];
+    _extPoints.push_back(Vector3f(s.v[0], s.v[1], s.v[2]));
   }
 }
@@ -59,7 +59,26 @@ private:
 	const Image& _edgeImage;
 	std::vector<Vector3f> _extPoints;
 	std::vector<Vector4f> _prospectiveCircles;
-	std::vector<std::vector<Vector2i> > _edges;
+
+	//-- Edge points of all subimages in one array, subimage b is [_bucketStarts[b], _bucketStarts[b+1])
+	struct EdgePoint
+	{
+	  short x, y;
+	};
+	std::vector<EdgePoint> _edges;
+	std::vector<int> _bucketStarts;
+	std::vector<EdgePoint> _unsortedEdges; //-- In the order of the image, before bucketing
+	std::vector<int> _keyStarts;           //-- Counting sort over (subimage, x), keeps each subimage ordered by x then y
+
+	//-- Prospective circles hashed by their quantized (cx, cy, r), chained through _gridEntries
+	struct GridEntry
+	{
+	  long long key; //-- Cell of the circle, or GRID_NONE if it can not be merged with anything
+	  int next;      //-- Next circle in the same bucket, or -1
+	};
+	std::vector<GridEntry> _gridEntries; //-- One per prospective circle
+	std::vector<int> _gridBuckets;       //-- First circle of each bucket, or -1
+	std::vector<int> _ranking;
 	int _pointsEachSegment;
 	float _selectingSigma;
 
@@ -68,5 +87,8 @@ private:
 	void selectRandomPoint();
 	void houghTransform(const Vector2i& p1, const Vector2i& p2, const Vector2i& p3);
 	void addCircle(const Vector3f& cirlce, int weight); //-- Accepting policy is here
+	long long gridKey(const Vector3f& circle, int dx, int dy, int dr) const;
+	void linkToGrid(int index);
+	void unlinkFromGrid(int index);
 	void extractResults();
 };
@@ -0,0 +1,145 @@
+/**
+ * @file SnapShotLogger.cpp
+ * Appends snap shots of ball candidates to one binary log file without ever
+ * blocking the thread taking them.
+ * @author <a href="mailto:agent@local">agent</a>
+ * @date Oct 2026
+ */
+
+#include "SnapShotLogger.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+static_assert(sizeof(SnapShotLogger::Header) == 48, "The header of the log file has to stay the same");
+
+SnapShotLogger::SnapShotLogger() :
+  _file(0),
+  _head(0),
+  _tail(0),
+  _sequence(0),
+  _written(0),
+  _dropped(0),
+  _stop(false)
+{
+}
+
+SnapShotLogger::~SnapShotLogger()
+{
+  close();
+}
+
+bool SnapShotLogger::open(const std::string& path)
+{
+  close();
+  _file = fopen(path.c_str(), "ab");
+  if (!_file)
+  {
+    std::cerr << "Can not open snap shot log " << path << "\n";
+    return false;
+  }
+
+  _ring.resize(SNAPSHOT_RING);
+  _head = _tail = 0;
+  _stop = false;
+  _writer = std::thread(&SnapShotLogger::write, this);
+  return true;
+}
+
+void SnapShotLogger::close()
+{
+  if (!_file)
+    return;
+
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stop = true;
+  }
+  _wake.notify_one();
+  _writer.join();
+
+  fclose(_file);
+  _file = 0;
+}
+
+bool SnapShotLogger::log(const Image& image, int cx, int cy, int r, int horizonY, unsigned flags)
+{
+  const unsigned sequence = _sequence++;
+  const unsigned head = _head.load(std::memory_order_relaxed);
+  if (!_file || head - _tail.load(std::memory_order_acquire) >= SNAPSHOT_RING)
+  {
+    ++_dropped;
+    return false;
+  }
+
+  Record& record = _ring[head % SNAPSHOT_RING];
+  Header& header = record.header;
+  header.magic = SNAPSHOT_MAGIC;
+  header.version = SNAPSHOT_VERSION;
+  header.headerSize = sizeof(Header);
+  header.patchWidth = header.patchHeight = SNAPSHOT_PATCH_WIDTH;
+  header.flags = flags;
+  header.time = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+  header.sequence = sequence;
+  header.cx = cx;
+  header.cy = cy;
+  header.r = r;
+  header.horizonY = horizonY;
+  header.frameWidth = image.width;
+  header.frameHeight = image.height;
+  std::fill(header.reserved, header.reserved + sizeof(header.reserved), 0);
+
+  //-- The square around the circle, black outside of the image
+  unsigned char* p = record.patch;
+  for (int j=0; j<SNAPSHOT_PATCH_WIDTH; ++j)
+    for (int i=0; i<SNAPSHOT_PATCH_WIDTH; ++i, p+=3)
+    {
+      const int x = 2*r*i/SNAPSHOT_PATCH_WIDTH + cx - r;
+      const int y = 2*r*j/SNAPSHOT_PATCH_WIDTH + cy - r;
+      if (x > -1 && x < image.width && y > -1 && y < image.height)
+      {
+        p[0] = image[y][x].y;
+        p[1] = image[y][x].cb;
+        p[2] = image[y][x].cr;
+      }
+      else
+        p[0] = p[1] = p[2] = 0;
+    }
+
+  _head.store(head + 1, std::memory_order_release);
+  return true;
+}
+
+void SnapShotLogger::write()
+{
+  std::unique_lock<std::mutex> lock(_mutex);
+  while (!_stop)
+  {
+    lock.unlock();
+    writeBatch();
+    lock.lock();
+    _wake.wait_for(lock, std::chrono::milliseconds(SNAPSHOT_WRITE_PERIOD), [this] { return _stop; });
+  }
+  lock.unlock();
+  writeBatch();
+}
+
+void SnapShotLogger::writeBatch()
+{
+  const unsigned head = _head.load(std::memory_order_acquire);
+  unsigned tail = _tail.load(std::memory_order_relaxed);
+  if (tail == head)
+    return;
+
+  for (; tail != head; ++tail)
+  {
+    const Record& record = _ring[tail % SNAPSHOT_RING];
+    fwrite(&record.header, sizeof(Header), 1, _file);
+    fwrite(record.patch, sizeof(record.patch), 1, _file);
+    ++_written;
+
+    //-- Giving the slot back as soon as it is copied into the buffer of the file
+    _tail.store(tail + 1, std::memory_order_release);
+  }
+  fflush(_file);
+}
@@ -0,0 +1,98 @@
+/**
+ * @file SnapShotLogger.h
+ * Appends snap shots of ball candidates to one binary log file without ever
+ * blocking the thread taking them. A snap shot is the patch around the
+ * candidate, sampled to a fixed size, after a fixed size header. Snap shots
+ * are copied into a preallocated ring and a thread of the logger writes them
+ * out in batches. When the ring is full, new snap shots are dropped.
+ * @author <a href="mailto:agent@local">agent</a>
+ * @date Oct 2026
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Representations/Infrastructure/Image.h"
+
+#define SNAPSHOT_MAGIC 0x534c524d      //-- "MRLS" in the file
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_PATCH_WIDTH 30        //-- Pixels of each side of the patch, y, cb and cr each
+#define SNAPSHOT_PATCH_SIZE (SNAPSHOT_PATCH_WIDTH*SNAPSHOT_PATCH_WIDTH*3)
+#define SNAPSHOT_RING 256              //-- Snap shots waiting for the writer
+#define SNAPSHOT_WRITE_PERIOD 50       //-- ms the writer sleeps between two batches
+
+class SnapShotLogger
+{
+public:
+  enum Flag
+  {
+    accepted = 1,  //-- Taken as the ball, otherwise rejected by the verification
+    requested = 2, //-- Asked for by the debug response, not sampled
+    lowerCamera = 4
+  };
+
+  //-- Written before each patch, all the records of a file have the same size
+  class Header
+  {
+  public:
+    uint32_t magic;
+    uint16_t version;
+    uint16_t headerSize;   //-- The patch starts after it
+    uint16_t patchWidth, patchHeight;
+    uint32_t flags;
+    uint64_t time;         //-- ms since the epoch
+    uint32_t sequence;     //-- Of the snap shots taken, missing ones were dropped
+    int16_t cx, cy, r;     //-- Of the candidate in the image
+    int16_t horizonY;
+    uint16_t frameWidth, frameHeight;
+    uint8_t reserved[8];
+  };
+
+  SnapShotLogger();
+  ~SnapShotLogger();
+
+  //-- Starts the writer appending to that file, false if it can not be opened
+  bool open(const std::string& path);
+
+  //-- Writes the snap shots still waiting and stops the writer
+  void close();
+
+  bool isOpen() const { return _file != 0; }
+
+  //-- Copies the patch of the circle to the ring, from one thread only. Returns false if the snap shot was
+  //-- dropped because the ring is full or the logger is not open.
+  bool log(const Image& image, int cx, int cy, int r, int horizonY, unsigned flags);
+
+  unsigned long long written() const { return _written; }
+  unsigned long long dropped() const { return _dropped; }
+
+private:
+  class Record
+  {
+  public:
+    Header header;
+    unsigned char patch[SNAPSHOT_PATCH_SIZE]; //-- y, cb, cr of each pixel, row by row
+  };
+
+  FILE* _file;
+  std::vector<Record> _ring;
+  std::atomic<unsigned> _head;  //-- Snap shots put into the ring, only changed by log
+  std::atomic<unsigned> _tail;  //-- Snap shots written, only changed by the writer
+  unsigned _sequence;
+  std::atomic<unsigned long long> _written, _dropped;
+
+  std::thread _writer;
+  std::mutex _mutex;            //-- Only for the writer sleeping, log never takes it
+  std::condition_variable _wake;
+  bool _stop;
+
+  void write();
+  void writeBatch();
+};
@@ -0,0 +1,84 @@
+/**
+ * @file WorkerPool.cpp
+ * A fixed set of threads running the jobs of one call at a time.
+ * @author <a href="mailto:agent@local">agent</a>
+ * @date Oct 2026
+ */
+
+#include "WorkerPool.h"
+
+WorkerPool::WorkerPool(unsigned threads) :
+  _job(0),
+  _jobs(0),
+  _next(0),
+  _busy(0),
+  _generation(0),
+  _stop(false)
+{
+  for (unsigned i=1; i<threads; ++i)
+    _threads.push_back(std::thread(&WorkerPool::work, this, i));
+}
+
+WorkerPool::~WorkerPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stop = true;
+  }
+  _wake.notify_all();
+  for (std::thread& t : _threads)
+    t.join();
+}
+
+void WorkerPool::run(unsigned jobs, const Job& job)
+{
+  if (_threads.empty() || jobs < 2)
+  {
+    for (unsigned i=0; i<jobs; ++i)
+      job(i, 0);
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _job = &job;
+    _jobs = jobs;
+    _next = 0;
+    _busy = _threads.size();
+    ++_generation;
+  }
+  _wake.notify_all();
+
+  execute(0);
+
+  std::unique_lock<std::mutex> lock(_mutex);
+  _done.wait(lock, [this] { return !_busy; });
+  _job = 0;
+}
+
+void WorkerPool::execute(unsigned worker)
+{
+  for (unsigned i = _next++; i < _jobs; i = _next++)
+    (*_job)(i, worker);
+}
+
+void WorkerPool::work(unsigned worker)
+{
+  unsigned generation = 0;
+  for (;;)
+  {
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _wake.wait(lock, [&] { return _stop || _generation != generation; });
+      if (_stop)
+        return;
+      generation = _generation;
+    }
+
+    execute(worker);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!--_busy)
+      _done.notify_one();
+  }
+}
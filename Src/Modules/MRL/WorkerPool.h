@@ -0,0 +1,49 @@
+/**
+ * @file WorkerPool.h
+ * A fixed set of threads running the jobs of one call at a time. The calling
+ * thread works on the jobs as well and returns when all of them are done.
+ * Jobs are handed out in order from a shared counter, so a job has to write
+ * only to its own results for the outcome to be independent of the threads.
+ * @author <a href="mailto:agent@local">agent</a>
+ * @date Oct 2026
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class WorkerPool
+{
+public:
+  //-- Gets the index of the job and the index of the worker running it, which is below size()
+  typedef std::function<void(unsigned job, unsigned worker)> Job;
+
+  WorkerPool(unsigned threads);
+  ~WorkerPool();
+
+  //-- Number of workers, including the calling thread
+  unsigned size() const { return _threads.size() + 1; }
+
+  void run(unsigned jobs, const Job& job);
+
+private:
+  std::vector<std::thread> _threads;
+  std::mutex _mutex;
+  std::condition_variable _wake;
+  std::condition_variable _done;
+
+  const Job* _job;
+  unsigned _jobs;
+  std::atomic<unsigned> _next;
+  unsigned _busy;       //-- Threads still working on the current call
+  unsigned _generation; //-- Counts the calls, tells the threads that there is new work
+  bool _stop;
+
+  void execute(unsigned worker);
+  void work(unsigned worker);
+};
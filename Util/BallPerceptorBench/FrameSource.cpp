@@ -0,0 +1,345 @@
+/**
+ * @file FrameSource.cpp
+ * Provides the frames replayed by the ball perceptor bench.
+ * @author <a href="mailto:agent@local">agent</a>
+ */
+
+#include "FrameSource.h"
+#include "Representations/Configuration/FieldDimensions.h"
+#include "Tools/Math/Geometry.h"
+#include "MRL/SnapShotLogger.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#define CAMERA_HEIGHT 450 //-- mm
+#define BOUNDARY_OFFSET 10 //-- Field boundary below the horizon, pixels
+#define ROLL_FRAMES 100    //-- Frames the moving ball takes from one random place on the field to the next
+#define HIDDEN_FRAMES 10   //-- Last frames of each roll with the ball occluded
+
+//-- Deterministic noise, so that every run replays the same pixels
+static inline unsigned hash(unsigned a)
+{
+  a = (a ^ 61) ^ (a >> 16);
+  a += (a << 3);
+  a ^= (a >> 4);
+  a *= 0x27d4eb2d;
+  a ^= (a >> 15);
+  return a;
+}
+
+static inline unsigned char clip(int v)
+{
+  return v < 0 ? 0 : (v > 255 ? 255 : v);
+}
+
+static inline void setPixel(Image::Pixel& p, int y, int cb, int cr, unsigned noise)
+{
+  p.y = clip(y + (int)(noise & 0xf) - 8);
+  p.cb = clip(cb + (int)((noise >> 4) & 0x7) - 4);
+  p.cr = clip(cr + (int)((noise >> 8) & 0x7) - 4);
+}
+
+FrameSource::FrameSource(int width, int height, unsigned seed) :
+  alternateCameras(false),
+  movingBall(false),
+  _width(width),
+  _height(height),
+  _seed(seed)
+{
+}
+
+bool FrameSource::addSnapShot(const std::string& metaFile)
+{
+  std::ifstream meta(metaFile);
+  if (!meta)
+  {
+    std::cerr << "Can not open meta-data " << metaFile << "\n";
+    return false;
+  }
+
+  //-- Each line is a value followed by a comment
+  int values[9];
+  std::string line;
+  for (int i = 0; i < 9; ++i)
+  {
+    if (!std::getline(meta, line) || !(std::istringstream(line) >> values[i]))
+    {
+      std::cerr << "Broken meta-data " << metaFile << "\n";
+      return false;
+    }
+  }
+
+  SnapShot snapShot;
+  snapShot.camera = CameraInfo::upper;
+  snapShot.bufferWidth = values[1];
+  snapShot.bufferHeight = values[2];
+  snapShot.cx = values[3];
+  snapShot.cy = values[4];
+  snapShot.r = values[5];
+  snapShot.horizonY = values[6];
+  snapShot.frameWidth = values[7];
+  snapShot.frameHeight = values[8];
+
+  if (values[0] != snapShot.bufferWidth * snapShot.bufferHeight * 3 ||
+      snapShot.frameWidth <= 0 || snapShot.frameWidth > Image::maxResolutionWidth ||
+      snapShot.frameHeight <= 0 || snapShot.frameHeight > Image::maxResolutionHeight)
+  {
+    std::cerr << "Unsupported meta-data " << metaFile << "\n";
+    return false;
+  }
+
+  const std::string imageFile = metaFile.substr(0, metaFile.rfind('.')) + ".image";
+  std::ifstream image(imageFile, std::ios::in | std::ios::binary);
+  snapShot.buffer.resize(values[0]);
+  if (!image || !image.read((char*) snapShot.buffer.data(), snapShot.buffer.size()))
+  {
+    std::cerr << "Can not read image " << imageFile << "\n";
+    return false;
+  }
+
+  _snapShots.push_back(snapShot);
+  return true;
+}
+
+bool FrameSource::addSnapShotLog(const std::string& logFile)
+{
+  std::ifstream log(logFile, std::ios::in | std::ios::binary);
+  if (!log)
+  {
+    std::cerr << "Can not open snap shot log " << logFile << "\n";
+    return false;
+  }
+
+  SnapShotLogger::Header header;
+  unsigned count = 0;
+  while (log.read((char*) &header, sizeof(header)))
+  {
+    if (header.magic != SNAPSHOT_MAGIC || header.version != SNAPSHOT_VERSION || header.headerSize != sizeof(header) ||
+        header.frameWidth <= 0 || header.frameWidth > Image::maxResolutionWidth ||
+        header.frameHeight <= 0 || header.frameHeight > Image::maxResolutionHeight)
+    {
+      std::cerr << "Broken snap shot " << count << " in " << logFile << "\n";
+      return false;
+    }
+
+    SnapShot snapShot;
+    snapShot.camera = header.flags & SnapShotLogger::lowerCamera ? CameraInfo::lower : CameraInfo::upper;
+    snapShot.bufferWidth = header.patchWidth;
+    snapShot.bufferHeight = header.patchHeight;
+    snapShot.cx = header.cx;
+    snapShot.cy = header.cy;
+    snapShot.r = header.r;
+    snapShot.horizonY = header.horizonY;
+    snapShot.frameWidth = header.frameWidth;
+    snapShot.frameHeight = header.frameHeight;
+    snapShot.buffer.resize(snapShot.bufferWidth * snapShot.bufferHeight * 3);
+    if (!log.read((char*) snapShot.buffer.data(), snapShot.buffer.size()))
+    {
+      std::cerr << "Truncated snap shot " << count << " in " << logFile << "\n";
+      return false;
+    }
+
+    _snapShots.push_back(snapShot);
+    ++count;
+  }
+  return true;
+}
+
+bool FrameSource::setRecording(const std::string& recordingFile)
+{
+  if (!_recording.open(recordingFile))
+    return false;
+  if (!_recording.frames())
+    std::cerr << "No frames in recording " << recordingFile << "\n";
+  return _recording.frames() > 0;
+}
+
+void FrameSource::fill(unsigned frame, Image& image, CameraInfo& cameraInfo, CameraMatrix& cameraMatrix, ImageCoordinateSystem& imageCoordinateSystem,
+                       FieldBoundary& fieldBoundary, BodyContour& bodyContour, ColorReference& colorReference) const
+{
+  if (_recording.frames())
+  {
+    _recording.fill(frame % _recording.frames(), image, cameraInfo, cameraMatrix, imageCoordinateSystem, fieldBoundary, bodyContour, colorReference);
+    return;
+  }
+
+  bodyContour.lines.clear();
+  image.timeStamp = frame + 1;
+
+  if (_snapShots.empty())
+  {
+    if (alternateCameras && frame % 2)
+      //-- Horizon above the image
+      setupCamera(CameraInfo::lower, _width / 2, _height / 2, -_height / 4, cameraInfo, cameraMatrix, imageCoordinateSystem, fieldBoundary);
+    else
+      //-- Horizon in the upper third of the image
+      setupCamera(CameraInfo::upper, _width, _height, _height / 5, cameraInfo, cameraMatrix, imageCoordinateSystem, fieldBoundary);
+    synthesize(frame, image, cameraInfo, cameraMatrix, fieldBoundary.getBoundaryY(0));
+  }
+  else
+  {
+    const SnapShot& snapShot = _snapShots[frame % _snapShots.size()];
+    setupCamera(snapShot.camera, snapShot.frameWidth, snapShot.frameHeight, snapShot.horizonY, cameraInfo, cameraMatrix, imageCoordinateSystem, fieldBoundary);
+    image.setResolution(snapShot.frameWidth, snapShot.frameHeight);
+    drawField(image, fieldBoundary.getBoundaryY(0), _seed + frame);
+    drawSnapShot(image, snapShot);
+  }
+}
+
+void FrameSource::setupCamera(CameraInfo::Camera camera, int width, int height, int horizonY, CameraInfo& cameraInfo, CameraMatrix& cameraMatrix,
+                              ImageCoordinateSystem& imageCoordinateSystem, FieldBoundary& fieldBoundary) const
+{
+  cameraInfo.camera = camera;
+  cameraInfo.width = width;
+  cameraInfo.height = height;
+  cameraInfo.focalLength = width * 543.f / 640.f; //-- NAO V5, about 61 degrees horizontal opening angle
+  cameraInfo.opticalCenter = Vector2<>(width / 2.f, height / 2.f);
+
+  //-- Tilting the camera so that the horizon is where it was recorded
+  cameraMatrix = CameraMatrix();
+  cameraMatrix.translation = Vector3<>(0, 0, CAMERA_HEIGHT);
+  cameraMatrix.rotation.rotateY(std::atan2(cameraInfo.opticalCenter.y - horizonY, cameraInfo.focalLength));
+
+  imageCoordinateSystem.origin = Vector2<>(cameraInfo.opticalCenter.x, (float) horizonY);
+
+  fieldBoundary.boundaryInImage.clear();
+  fieldBoundary.boundaryInImage.push_back(Vector2i(0, horizonY + BOUNDARY_OFFSET));
+  fieldBoundary.boundaryInImage.push_back(Vector2i(width - 1, horizonY + BOUNDARY_OFFSET));
+  fieldBoundary.isValid = true;
+}
+
+void FrameSource::drawField(Image& image, int boundaryY, unsigned seed) const
+{
+  for (int y = 0; y < image.height; ++y)
+    for (int x = 0; x < image.width; ++x)
+    {
+      const unsigned noise = hash(seed * 0x9e3779b9u + y * image.width + x);
+      if (y < boundaryY)
+        setPixel(image[y][x], 150, 134, 122, noise); //-- Not field
+      else
+        setPixel(image[y][x], 90, 96, 100, noise);   //-- Green carpet
+    }
+}
+
+void FrameSource::drawBall(Image& image, int cx, int cy, int r, unsigned seed) const
+{
+  //-- One black patch in the middle and five around it
+  Vector2i patches[6];
+  patches[0] = Vector2i(cx, cy);
+  for (int i = 1; i < 6; ++i)
+  {
+    const float a = i * 2 * M_PI / 5 + (seed % 628) / 100.f;
+    patches[i] = Vector2i(cx + 0.8f * r * std::cos(a), cy + 0.8f * r * std::sin(a));
+  }
+  const int patchR2 = r * r / 10;
+
+  for (int y = cy - r; y <= cy + r; ++y)
+    for (int x = cx - r; x <= cx + r; ++x)
+    {
+      if (x < 0 || y < 0 || x >= image.width || y >= image.height ||
+          (x - cx) * (x - cx) + (y - cy) * (y - cy) > r * r)
+        continue;
+
+      bool black = false;
+      for (const Vector2i& p : patches)
+        black |= (x - p.x) * (x - p.x) + (y - p.y) * (y - p.y) < patchR2;
+
+      const unsigned noise = hash(seed + y * image.width + x);
+      if (black)
+        setPixel(image[y][x], 30, 128, 128, noise);
+      else
+        setPixel(image[y][x], 210, 128, 128, noise);
+    }
+}
+
+void FrameSource::drawSnapShot(Image& image, const SnapShot& snapShot) const
+{
+  //-- Inverse of the sampling in SnapShotLogger::log
+  const int r = snapShot.r > 0 ? snapShot.r : 1;
+  for (int y = snapShot.cy - r; y < snapShot.cy + r; ++y)
+    for (int x = snapShot.cx - r; x < snapShot.cx + r; ++x)
+    {
+      if (x < 0 || y < 0 || x >= image.width || y >= image.height)
+        continue;
+
+      const int i = (x - snapShot.cx + r) * snapShot.bufferWidth / (2 * r);
+      const int j = (y - snapShot.cy + r) * snapShot.bufferHeight / (2 * r);
+      const unsigned char* p = &snapShot.buffer[(j * snapShot.bufferWidth + i) * 3];
+      image[y][x].y = p[0];
+      image[y][x].cb = p[1];
+      image[y][x].cr = p[2];
+    }
+}
+
+bool FrameSource::rollingBall(unsigned frame, Vector3<>& onField) const
+{
+  const unsigned roll = frame / ROLL_FRAMES;
+  const unsigned t = frame % ROLL_FRAMES;
+  if (t >= ROLL_FRAMES - HIDDEN_FRAMES)
+    return false;
+
+  //-- From 40cm to 3m in front of the robot and up to 1.2m to each side, mm
+  const unsigned from = hash(_seed * 0x9e3779b9u + roll);
+  const unsigned to = hash(_seed * 0x9e3779b9u + roll + 1);
+  const Vector2<> start(400.f + from % 2600, (int)((from >> 12) % 2400) - 1200.f);
+  const Vector2<> end(400.f + to % 2600, (int)((to >> 12) % 2400) - 1200.f);
+  const Vector2<> position = start + (end - start) * ((float) t / ROLL_FRAMES);
+  onField = Vector3<>(position.x, position.y, (float) FieldDimensions().ballRadius);
+  return true;
+}
+
+void FrameSource::synthesize(unsigned frame, Image& image, const CameraInfo& cameraInfo, const CameraMatrix& cameraMatrix, int boundaryY) const
+{
+  const unsigned seed = hash(_seed + frame);
+  const int width = cameraInfo.width;
+  const int height = cameraInfo.height;
+  image.setResolution(width, height);
+  drawField(image, boundaryY, seed);
+
+  //-- A few field lines
+  const int lines = seed % 3;
+  for (int l = 0; l < lines; ++l)
+  {
+    const unsigned s = hash(seed + l + 1);
+    const int x0 = s % width;
+    const int x1 = (s >> 12) % width;
+    const int thickness = 2 + (s >> 24) % 4;
+    for (int y = std::max(boundaryY, 0); y < height; ++y)
+    {
+      const int x = x0 + (x1 - x0) * (y - boundaryY) / (height - boundaryY);
+      for (int t = 0; t < thickness + (y - boundaryY) / 40; ++t)
+        if (x + t < width)
+          setPixel(image[y][x + t], 200, 130, 126, hash(s + y * width + x + t));
+    }
+  }
+
+  Vector3<> onField;
+  int x, y;
+  const unsigned s = hash(seed ^ 0xba11);
+  if (movingBall)
+  {
+    Vector2<> inImage;
+    if (!rollingBall(frame, onField) || !Geometry::calculatePointInImage(onField, cameraMatrix, cameraInfo, inImage))
+      return;
+    x = (int) inImage.x;
+    y = (int) inImage.y;
+  }
+  else
+  {
+    //-- Every fourth frame has no ball
+    if (frame % 4 == 3)
+      return;
+
+    //-- Placing the ball on the field and taking its radius from the projection
+    x = s % width;
+    y = boundaryY + 8 + (s >> 10) % (height - boundaryY - 8);
+    if (!Geometry::calculatePointOnField(Vector2<>(x, y), FieldDimensions().ballRadius, cameraMatrix, cameraInfo, onField))
+      return;
+  }
+  const float distance = (onField - cameraMatrix.translation).abs();
+  const int r = cameraInfo.focalLength * FieldDimensions().ballRadius / distance;
+  drawBall(image, x, y, r, s);
+}
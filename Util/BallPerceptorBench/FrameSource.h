@@ -0,0 +1,76 @@
+/**
+ * @file FrameSource.h
+ * Provides the frames replayed by the ball perceptor bench. The frames are
+ * either rebuilt from the snap shots taken by BallPerceptor::takeASnapShot,
+ * one `.meta' file each or many of them in a log of the SnapShotLogger,
+ * replayed from a FrameRecording or synthesized from a seed, so that every run sees the same input.
+ * @author <a href="mailto:agent@local">agent</a>
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "Representations/Infrastructure/Image.h"
+#include "Representations/Infrastructure/CameraInfo.h"
+#include "Representations/Perception/CameraMatrix.h"
+#include "Representations/Perception/ImageCoordinateSystem.h"
+#include "Representations/Perception/FieldBoundary.h"
+#include "Representations/Perception/BodyContour.h"
+#include "Representations/Perception/ColorReference.h"
+#include "MRL/FrameRecording.h"
+
+class FrameSource
+{
+public:
+  FrameSource(int width, int height, unsigned seed);
+
+  //-- Loads a `.meta' file and the `.image' file next to it
+  bool addSnapShot(const std::string& metaFile);
+
+  //-- Loads all the snap shots of a log file of the SnapShotLogger
+  bool addSnapShotLog(const std::string& logFile);
+
+  //-- Maps a recording, all the frames are replayed from it then
+  bool setRecording(const std::string& recordingFile);
+
+  //-- Number of recorded frames or loaded snap shots, without any the frames are synthesized
+  unsigned size() const { return _recording.frames() ? _recording.frames() : _snapShots.size(); }
+
+  //-- Only frames of a recording change the color reference, their images refer to the mapped file
+  void fill(unsigned frame, Image& image, CameraInfo& cameraInfo, CameraMatrix& cameraMatrix, ImageCoordinateSystem& imageCoordinateSystem,
+            FieldBoundary& fieldBoundary, BodyContour& bodyContour, ColorReference& colorReference) const;
+
+  //-- Every other synthetic frame comes from the lower camera, at half the resolution and looking down
+  bool alternateCameras;
+
+  //-- The synthetic ball rolls on the field from frame to frame instead of jumping around
+  bool movingBall;
+
+private:
+  class SnapShot
+  {
+  public:
+    CameraInfo::Camera camera;
+    int bufferWidth, bufferHeight;
+    int cx, cy, r;
+    int horizonY;
+    int frameWidth, frameHeight;
+    std::vector<unsigned char> buffer; //-- y, cb, cr for each pixel
+  };
+
+  int _width;
+  int _height;
+  unsigned _seed;
+  std::vector<SnapShot> _snapShots;
+  FrameRecording _recording;
+
+  void setupCamera(CameraInfo::Camera camera, int width, int height, int horizonY, CameraInfo& cameraInfo, CameraMatrix& cameraMatrix,
+                   ImageCoordinateSystem& imageCoordinateSystem, FieldBoundary& fieldBoundary) const;
+  void drawField(Image& image, int boundaryY, unsigned seed) const;
+  void drawBall(Image& image, int cx, int cy, int r, unsigned seed) const;
+  void drawSnapShot(Image& image, const SnapShot& snapShot) const;
+  bool rollingBall(unsigned frame, Vector3<>& onField) const;
+  void synthesize(unsigned frame, Image& image, const CameraInfo& cameraInfo, const CameraMatrix& cameraMatrix, int boundaryY) const;
+};
@@ -0,0 +1,314 @@
+/**
+ * @file Main.cpp
+ * Replays recorded or synthetic frames through EdgeImage, FRHT and the
+ * BallPerceptor filters outside of the framework and reports the time spent
+ * in each stage as min / median / p99 over all frames.
+ *
+ * Usage: ballPerceptorBench [-n frames] [-s seed] [-w width] [-y height] [-L] [-M] [-V threads] [-E threads] [-F threads] [-B budget[,lower]] [-S snapShots.log] [-W recording.rec] [-T trace.json] [-H] [-t threads] [-p step] [-R] [file.meta ...]
+ * With -L every other synthetic frame is from the lower camera at half the resolution.
+ * With -M the synthetic ball rolls over the field instead of jumping from frame to frame.
+ * -V verifies the candidates of the perceptor in parallel with that many threads,
+ * -E searches its edges with that many, -F runs that many times the FRHT iterations
+ * concurrently on that many. -B runs the perceptor in its anytime mode with that budget
+ * in microseconds per image, the second one for the lower camera, and reports how much
+ * of it was used. -S logs snap shots of all the accepted and every 16th rejected
+ * candidate to that file, which can be replayed as any other file not ending in
+ * `.meta' or `.rec'. -W records all the frames the perceptor gets with their
+ * representations into that file, files ending in `.rec' are replayed from such
+ * recordings. -T writes the last events of the instrumentation as a
+ * Chrome trace and prints its histograms.
+ * With -H the full hough transform also runs on all the edges of each frame,
+ * -t sets the number of threads it uses and -p its coarse step. -R runs the
+ * random hough transform on an edge image of each frame.
+ * @author <a href="mailto:agent@local">agent</a>
+ */
+
+#include "FrameSource.h"
+#include "Modules/BallPerceptor.h"
+#include "MRL/EdgeImage.h"
+#include "MRL/HoughTrans.h"
+#include "MRL/RHT.h"
+#include "MRL/Instrumentation.h"
+#include "Tools/Debugging/Stopwatch.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#define HOUGH_EDGE_CONTRAST 48 //-- Difference in y to a neighbour that makes an edge, far above the noise of the synthetic frames
+
+static void usage(const char* name)
+{
+  std::cerr << "Usage: " << name << " [-n frames] [-s seed] [-w width] [-y height] [-L] [-M] [-V threads] [-E threads] [-F threads] [-B budget[,lower]] [-S snapShots.log] [-W recording.rec] [-T trace.json] [-H] [-t threads] [-p step] [-R] [file.meta ...]\n"
+            << "  Without any snap shot, synthetic frames are generated from the seed, -w and -y set their size.\n"
+            << "  -L makes every other synthetic frame a lower camera one at half the resolution.\n"
+            << "  -M makes the synthetic ball roll over the field, as when it is tracked.\n"
+            << "  -V verifies all the candidates with that many threads and takes the best one.\n"
+            << "  -E searches the edges of the perceptor with that many threads.\n"
+            << "  -F runs that many times the FRHT iterations of the perceptor on that many threads.\n"
+            << "  -B gives the perceptor a budget in microseconds per image, optionally another one for\n"
+            << "  the lower camera, and reports the part of it used.\n"
+            << "  -S logs snap shots of the accepted and some of the rejected candidates to that file,\n"
+            << "  files not ending in .meta or .rec are read as such logs.\n"
+            << "  -W records the frames with all the representations the perceptor reads to that file,\n"
+            << "  files ending in .rec are replayed from such recordings.\n"
+            << "  -T writes a Chrome trace of the last frames and prints the latency histograms.\n"
+            << "  -H also runs the full hough transform on all the edges of each frame, with -t threads\n"
+            << "  and -p as the coarse step of its pyramid. -R runs the random hough transform on its edge image.\n";
+}
+
+//-- Sets the pixels differing from their right or lower neighbour by more than HOUGH_EDGE_CONTRAST
+//-- to 255 and all others to 0. Unlike the scan graph of the edge image, this finds the whole
+//-- outline of a ball, so the hough transform gets enough votes for its center.
+static void markEdges(const Image& image, Image& edges)
+{
+  edges.setResolution(image.width, image.height);
+  for (int y = 0; y < image.height; ++y)
+    for (int x = 0; x < image.width; ++x)
+    {
+      const int v = image[y][x].y;
+      const bool edge = (x + 1 < image.width && std::abs(v - image[y][x + 1].y) > HOUGH_EDGE_CONTRAST) ||
+                        (y + 1 < image.height && std::abs(v - image[y + 1][x].y) > HOUGH_EDGE_CONTRAST);
+      edges[y][x].color = 0;
+      edges[y][x].y = edge ? 255 : 0;
+    }
+}
+
+static unsigned long long percentile(const std::vector<unsigned long long>& sorted, float p)
+{
+  const unsigned i = (unsigned)(p * (sorted.size() - 1) + 0.5f);
+  return sorted[i];
+}
+
+int main(int argc, char** argv)
+{
+  unsigned frames = 3000;
+  unsigned seed = 1;
+  int width = 640, height = 480;
+  bool alternateCameras = false;
+  bool movingBall = false;
+  unsigned verificationThreads = 0;
+  unsigned edgeThreads = 1;
+  unsigned houghThreads = 0;
+  unsigned upperBudget = 0, lowerBudget = 0;
+  std::string snapShotLog;
+  std::string recordingFile;
+  std::string traceFile;
+  bool hough = false;
+  unsigned threads = 1;
+  unsigned coarseStep = 1;
+  bool randomHough = false;
+  std::vector<std::string> metaFiles;
+
+  for (int i = 1; i < argc; ++i)
+  {
+    if (!strcmp(argv[i], "-n") && i + 1 < argc)
+      frames = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-s") && i + 1 < argc)
+      seed = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-w") && i + 1 < argc)
+      width = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-y") && i + 1 < argc)
+      height = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-L"))
+      alternateCameras = true;
+    else if (!strcmp(argv[i], "-M"))
+      movingBall = true;
+    else if (!strcmp(argv[i], "-V") && i + 1 < argc)
+      verificationThreads = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-E") && i + 1 < argc)
+      edgeThreads = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-F") && i + 1 < argc)
+      houghThreads = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-B") && i + 1 < argc)
+    {
+      const char* budget = argv[++i];
+      upperBudget = lowerBudget = atoi(budget);
+      if (strchr(budget, ','))
+        lowerBudget = atoi(strchr(budget, ',') + 1);
+    }
+    else if (!strcmp(argv[i], "-S") && i + 1 < argc)
+      snapShotLog = argv[++i];
+    else if (!strcmp(argv[i], "-W") && i + 1 < argc)
+      recordingFile = argv[++i];
+    else if (!strcmp(argv[i], "-T") && i + 1 < argc)
+      traceFile = argv[++i];
+    else if (!strcmp(argv[i], "-H"))
+      hough = true;
+    else if (!strcmp(argv[i], "-t") && i + 1 < argc)
+      threads = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-p") && i + 1 < argc)
+      coarseStep = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-R"))
+      randomHough = true;
+    else if (!strcmp(argv[i], "-h"))
+    {
+      usage(argv[0]);
+      return 0;
+    }
+    else if (argv[i][0] == '-')
+    {
+      usage(argv[0]);
+      return 1;
+    }
+    else
+      metaFiles.push_back(argv[i]);
+  }
+
+  if (width <= 0 || width > Image::maxResolutionWidth || height <= 0 || height > Image::maxResolutionHeight || !frames || !threads || !edgeThreads || !coarseStep)
+  {
+    usage(argv[0]);
+    return 1;
+  }
+
+  FrameSource source(width, height, seed);
+  source.alternateCameras = alternateCameras;
+  source.movingBall = movingBall;
+  for (const std::string& file : metaFiles)
+    if (file.size() > 5 && !file.compare(file.size() - 5, 5, ".meta"))
+      source.addSnapShot(file);
+    else if (file.size() > 4 && !file.compare(file.size() - 4, 4, ".rec"))
+      source.setRecording(file);
+    else
+      source.addSnapShotLog(file);
+  if (!metaFiles.empty() && !source.size())
+    return 1;
+
+  //-- Separate from the perceptor, so that its edge image stays untouched. RHT draws
+  //-- from the same random numbers as FRHT, so -R changes the percepts.
+  const Image& image = blackboardRepresentation<Image>();
+  EdgeImage edgeImage(image);
+  edgeImage.setThreads(threads);
+  static Image houghEdges; //-- Too large for the stack
+  HoughTrans houghTrans(houghEdges, threads);
+  houghTrans.coarseStep = coarseStep;
+  RHT rht(edgeImage);
+  unsigned houghPoints = 0;
+  unsigned houghChecksum = 0;
+  unsigned rhtChecksum = 0;
+
+  //-- Instead of the ones of ballPerceptor.cfg
+  moduleParameters()["verificationThreads"] = std::to_string(verificationThreads);
+  moduleParameters()["edgeThreads"] = std::to_string(edgeThreads);
+  moduleParameters()["houghThreads"] = std::to_string(houghThreads);
+  moduleParameters()["upperTimeBudget"] = std::to_string(upperBudget);
+  moduleParameters()["lowerTimeBudget"] = std::to_string(lowerBudget);
+  moduleParameters()["snapShotLog"] = snapShotLog;
+  moduleParameters()["snapShotEveryAccepted"] = "1";
+  moduleParameters()["snapShotEveryRejected"] = "16";
+  moduleParameters()["recordingFile"] = recordingFile;
+  moduleParameters()["recordEveryImage"] = "1";
+
+  BallPerceptor* perceptor = new BallPerceptor;
+  if (!snapShotLog.empty() && !perceptor->snapShotLogger().isOpen())
+    return 1;
+  if (!recordingFile.empty() && !perceptor->frameRecorder().isOpen())
+    return 1;
+  perceptor->frameRecorder().waitForWriter = true; //-- All the frames, the bench is no real time
+  BallPerceptorBase& module = *perceptor;
+  srand(seed); //-- FRHT and RHT seed with the time, replays must not
+
+  std::map<std::string, std::vector<unsigned long long> > samples;
+  std::vector<float> usedBudget[2]; //-- Of each camera
+  unsigned seen = 0;
+  unsigned checksum = 0; //-- Same input and seed has to give the same percepts after optimizations
+  for (unsigned frame = 0; frame < frames; ++frame)
+  {
+    source.fill(frame,
+                blackboardRepresentation<Image>(),
+                blackboardRepresentation<CameraInfo>(),
+                blackboardRepresentation<CameraMatrix>(),
+                blackboardRepresentation<ImageCoordinateSystem>(),
+                blackboardRepresentation<FieldBoundary>(),
+                blackboardRepresentation<BodyContour>(),
+                blackboardRepresentation<ColorReference>());
+
+    BallPercept ballPercept;
+    Stopwatch::frameTimes().clear();
+    STOP_TIME_ON_REQUEST("total", module.update(ballPercept); );
+
+    if (randomHough)
+      STOP_TIME_ON_REQUEST("hough:edgeImage", edgeImage.update(); );
+    if (hough)
+    {
+      STOP_TIME_ON_REQUEST("hough:edges", markEdges(image, houghEdges); );
+      STOP_TIME_ON_REQUEST("hough:houghTrans", houghTrans.update(); );
+      for (const Vector4i& p : houghTrans.extractedPoints())
+        houghChecksum = houghChecksum * 31 + p[0] * 7 + p[1] * 5 + p[2] * 3 + p[3];
+      houghPoints += houghTrans.extractedPoints().size();
+    }
+    if (randomHough)
+    {
+      STOP_TIME_ON_REQUEST("hough:rht", rht.update(); );
+      for (const Vector3f& c : rht.extractedPoints())
+        rhtChecksum = rhtChecksum * 31 + (unsigned)(c.x * 16) * 7 + (unsigned)(c.y * 16) * 3 + (unsigned)(c.z * 16);
+    }
+
+    const CameraInfo::Camera camera = blackboardRepresentation<CameraInfo>().camera;
+    if (upperBudget || lowerBudget)
+      usedBudget[camera].push_back(perceptor->usedBudget(camera));
+
+    for (const auto& t : Stopwatch::frameTimes())
+      samples[t.first].push_back(t.second);
+    seen += ballPercept.ballWasSeen;
+    if (ballPercept.ballWasSeen)
+      checksum = checksum * 31 + (unsigned)(ballPercept.positionInImage.x * 16) * 7 +
+                 (unsigned)(ballPercept.positionInImage.y * 16) * 3 + (unsigned)(ballPercept.radiusInImage * 16);
+  }
+
+  printf("%u frames, %u with ball seen, percept checksum %08x\n", frames, seen, checksum);
+  if (hough)
+    printf("%u hough circles, hough checksum %08x\n", houghPoints, houghChecksum);
+  if (randomHough)
+    printf("rht checksum %08x\n", rhtChecksum);
+  for (int camera = 0; camera < 2; ++camera)
+  {
+    std::vector<float>& used = usedBudget[camera];
+    if (used.empty())
+      continue;
+    std::sort(used.begin(), used.end());
+    const unsigned overruns = used.end() - std::upper_bound(used.begin(), used.end(), 1.f);
+    printf("%s budget %u us: median %.0f%%, p99 %.0f%%, max %.0f%% used, %u of %u images over it\n",
+           camera == CameraInfo::upper ? "upper" : "lower", camera == CameraInfo::upper ? upperBudget : lowerBudget,
+           used[used.size() / 2] * 100, used[(unsigned)(0.99f * (used.size() - 1) + 0.5f)] * 100, used.back() * 100,
+           overruns, (unsigned) used.size());
+  }
+  if (!snapShotLog.empty())
+  {
+    SnapShotLogger& logger = perceptor->snapShotLogger();
+    logger.close(); //-- Closing the log writes the rest
+    printf("%llu snap shots written, %llu dropped\n", logger.written(), logger.dropped());
+  }
+  if (!recordingFile.empty())
+  {
+    FrameRecorder& recorder = perceptor->frameRecorder();
+    recorder.close(); //-- Closing the recording writes the rest and the index
+    printf("%llu frames recorded, %llu dropped\n", recorder.written(), recorder.dropped());
+  }
+  printf("\n");
+  printf("%-48s %8s %10s %10s %10s\n", "stage", "frames", "min[us]", "median[us]", "p99[us]");
+  for (auto& s : samples)
+  {
+    std::sort(s.second.begin(), s.second.end());
+    printf("%-48s %8u %10.1f %10.1f %10.1f\n", s.first.c_str(), (unsigned) s.second.size(),
+           s.second.front() / 1000.0, percentile(s.second, 0.5f) / 1000.0, percentile(s.second, 0.99f) / 1000.0);
+  }
+
+  if (!traceFile.empty())
+  {
+    std::ofstream trace(traceFile);
+    Instrumentation::get().writeChromeTrace(trace);
+    printf("\n");
+    fflush(stdout);
+    Instrumentation::get().writeHistograms(std::cout);
+  }
+
+  delete perceptor;
+  return 0;
+}
@@ -0,0 +1,15 @@
+/**
+ * @file FieldDimensions.h
+ * Stand-in for the framework's field dimensions.
+ * @author <a href="mailto:agent@local">agent</a>
+ */
+
+#pragma once
+
+class FieldDimensions
+{
+public:
+  FieldDimensions() : ballRadius(50) {}
+
+  int ballRadius;
+};
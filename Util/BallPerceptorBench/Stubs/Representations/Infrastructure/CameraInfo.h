@@ -0,0 +1,27 @@
+/**
+ * @file CameraInfo.h
+ * Stand-in for the framework's camera intrinsics.
+ * @author <a href="mailto:agent@local">agent</a>
+ */
+
+#pragma once
+
+#include "Tools/Math/Vector.h"
+
+class CameraInfo
+{
+public:
+  enum Camera
+  {
+    upper,
+    lower
+  };
+
+  CameraInfo() : camera(upper), width(640), height(480), focalLength(543.f), opticalCenter(320.f, 240.f) {}
+
+  Camera camera;
+  int width;
+  int height;
+  float focalLength;
+  Vector2<> opticalCenter;
+};
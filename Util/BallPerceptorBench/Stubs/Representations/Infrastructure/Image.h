@@ -0,0 +1,72 @@
+/**
+ * @file Image.h
+ * Stand-in for the framework's YCbCr image.
+ * @author <a href="mailto:agent@local">agent</a>
+ */
+
+#pragma once
+
+class Image
+{
+public:
+  enum
+  {
+    maxResolutionWidth = 640,
+    maxResolutionHeight = 480
+  };
+
+  union Pixel
+  {
+    unsigned color;
+    struct
+    {
+      unsigned char yCbCrPadding,
+               cb,
+               y,
+               cr;
+    };
+  };
+
+  Image() : width(0), height(0), timeStamp(0), isReference(false), image(pixels[0]) {}
+
+  Image(const Image& other) : Image() { *this = other; }
+
+  //-- Copies the pixels, also the ones of a reference
+  Image& operator=(const Image& other)
+  {
+    width = other.width;
+    height = other.height;
+    timeStamp = other.timeStamp;
+    for (int y = 0; y < height; ++y)
+      for (int x = 0; x < width; ++x)
+        pixels[y][x] = other[y][x];
+    isReference = false;
+    image = pixels[0];
+    return *this;
+  }
+
+  void setResolution(int newWidth, int newHeight)
+  {
+    width = newWidth;
+    height = newHeight;
+  }
+
+  //-- Uses the pixels of the buffer instead of its own, rows of maxResolutionWidth pixels, without copying them
+  void setImage(const unsigned char* buffer)
+  {
+    image = (Pixel*) buffer;
+    isReference = true;
+  }
+
+  Pixel* operator[](const int y) { return image + y * maxResolutionWidth; }
+  const Pixel* operator[](const int y) const { return image + y * maxResolutionWidth; }
+
+  int width;
+  int height;
+  unsigned timeStamp;
+  bool isReference; //-- Of the buffer of setImage, which must not be written then
+
+private:
+  Pixel pixels[maxResolutionHeight][maxResolutionWidth];
+  Pixel* image;
+};
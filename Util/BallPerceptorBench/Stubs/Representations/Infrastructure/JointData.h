@@ -0,0 +1,11 @@
+/**
+ * @file JointData.h
+ * Stand-in for the framework's joint data, the ball perceptor does not read it.
+ * @author <a href="mailto:agent@local">agent</a>
+ */
+
+#pragma once
+
+class FilteredJointData
+{
+};
@@ -0,0 +1,27 @@
+/**
+ * @file BallPercept.h
+ * Stand-in for the framework's ball percept.
+ * @author <a href="mailto:agent@local">agent</a>
+ */
+
+#pragma once
+
+#include "Tools/Math/Vector.h"
+
+class BallPercept
+{
+public:
+  enum Status
+  {
+    notSeen,
+    seen
+  };
+
+  BallPercept() : radiusInImage(0), ballWasSeen(false), status(notSeen) {}
+
+  Vector2<> positionInImage;
+  float radiusInImage;
+  bool ballWasSeen;
+  Vector2<> relativePositionOnField;
+  Status status;
+};
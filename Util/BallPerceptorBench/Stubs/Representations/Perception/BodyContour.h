@@ -0,0 +1,36 @@
+/**
+ * @file BodyContour.h
+ * Stand-in for the framework's body contour.
+ * @author <a href="mailto:agent@local">agent</a>
+ */
+
+#pragma once
+
+#include <vector>
+#include "Tools/Math/Vector.h"
+
+class BodyContour
+{
+public:
+  class Line
+  {
+  public:
+    Line() {}
+    Line(const Vector2i& p1, const Vector2i& p2) : p1(p1), p2(p2) {}
+    Vector2i p1, p2; //-- p1.x < p2.x
+  };
+
+  std::vector<Line> lines;
+
+  //-- Moves y up to the contour if the point (x, y) lies inside the robot's body
+  void clipBottom(int x, int& y) const
+  {
+    for (const Line& line : lines)
+      if (line.p1.x <= x && x < line.p2.x)
+      {
+        const int lineY = line.p1.y + (line.p2.y - line.p1.y) * (x - line.p1.x) / (line.p2.x - line.p1.x);
+        if (y > lineY)
+          y = lineY;
+      }
+  }
+};
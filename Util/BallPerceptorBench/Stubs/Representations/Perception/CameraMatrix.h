@@ -0,0 +1,18 @@
+/**
+ * @file CameraMatrix.h
+ * Stand-in for the framework's camera matrix.
+ * @author <a href="mailto:agent@local">agent</a>
+ */
+
+#pragma once
+
+#include "Tools/Math/Pose3D.h"
+#include "Representations/Infrastructure/CameraInfo.h"
+
+class CameraMatrix : public Pose3D
+{
+public:
+  CameraMatrix() : isValid(true) {}
+
+  bool isValid;
+};
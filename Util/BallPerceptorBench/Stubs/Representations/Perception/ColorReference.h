@@ -0,0 +1,46 @@
+/**
+ * @file ColorReference.h
+ * Stand-in for the framework's color calibration. Each color class is a box
+ * in the YCbCr space. As advised in the README, black is calibrated as orange.
+ * @author <a href="mailto:agent@local">agent</a>
+ */
+
+#pragma once
+
+#include "Representations/Infrastructure/Image.h"
+
+class ColorReference
+{
+public:
+  class Threshold
+  {
+  public:
+    Threshold(int minY, int maxY, int minCb, int maxCb, int minCr, int maxCr) :
+      minY(minY), maxY(maxY), minCb(minCb), maxCb(maxCb), minCr(minCr), maxCr(maxCr) {}
+
+    bool contains(const Image::Pixel* p) const
+    {
+      return p->y >= minY && p->y <= maxY && p->cb >= minCb && p->cb <= maxCb && p->cr >= minCr && p->cr <= maxCr;
+    }
+
+    int minY, maxY, minCb, maxCb, minCr, maxCr;
+  };
+
+  ColorReference() :
+    thresholdGreen(40, 180, 0, 118, 0, 118),
+    thresholdWhite(170, 255, 108, 148, 108, 148),
+    thresholdOrange(0, 60, 100, 156, 100, 156),
+    thresholdBlue(0, 200, 150, 255, 0, 120),
+    changed(false) {}
+
+  bool isGreen(const Image::Pixel* p) const { return thresholdGreen.contains(p); }
+  bool isWhite(const Image::Pixel* p) const { return thresholdWhite.contains(p); }
+  bool isOrange(const Image::Pixel* p) const { return thresholdOrange.contains(p); }
+  bool isBlue(const Image::Pixel* p) const { return thresholdBlue.contains(p); }
+
+  Threshold thresholdGreen;
+  Threshold thresholdWhite;
+  Threshold thresholdOrange;
+  Threshold thresholdBlue;
+  bool changed; //-- set for one frame whenever the calibration was modified
+};
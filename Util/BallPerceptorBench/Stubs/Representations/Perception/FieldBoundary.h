@@ -0,0 +1,35 @@
+/**
+ * @file FieldBoundary.h
+ * Stand-in for the framework's field boundary.
+ * @author <a href="mailto:agent@local">agent</a>
+ */
+
+#pragma once
+
+#include <vector>
+#include "Tools/Math/Vector.h"
+
+class FieldBoundary
+{
+public:
+  FieldBoundary() : isValid(false) {}
+
+  std::vector<Vector2i> boundaryInImage; //-- sorted by x
+  bool isValid;
+
+  int getBoundaryY(int x) const
+  {
+    if (boundaryInImage.empty())
+      return 0;
+    if (x <= boundaryInImage.front().x)
+      return boundaryInImage.front().y;
+    for (unsigned i = 1; i < boundaryInImage.size(); ++i)
+    {
+      const Vector2i& a = boundaryInImage[i - 1];
+      const Vector2i& b = boundaryInImage[i];
+      if (x <= b.x)
+        return b.x == a.x ? b.y : a.y + (b.y - a.y) * (x - a.x) / (b.x - a.x);
+    }
+    return boundaryInImage.back().y;
+  }
+};
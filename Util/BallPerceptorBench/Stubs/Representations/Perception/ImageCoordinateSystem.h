@@ -0,0 +1,19 @@
+/**
+ * @file ImageCoordinateSystem.h
+ * Stand-in for the framework's image coordinate system, without any
+ * rolling shutter or distortion correction.
+ * @author <a href="mailto:agent@local">agent</a>
+ */
+
+#pragma once
+
+#include "Tools/Math/Vector.h"
+
+class ImageCoordinateSystem
+{
+public:
+  Vector2<> origin;
+
+  Vector2<> toCorrected(const Vector2<>& point) const { return point; }
+  Vector2<> fromCorrected(const Vector2<>& point) const { return point; }
+};
@@ -0,0 +1,16 @@
+/**
+ * @file DebugDrawings.h
+ * Stand-in for the framework's debug drawings, everything compiles to nothing.
+ * The body of a debug response is still compiled, it is just never run.
+ * @author <a href="mailto:agent@local">agent</a>
+ */
+
+#pragma once
+
+#define DEBUG_RESPONSE(id, ...) do { if (false) { __VA_ARGS__ } } while (false)
+#define DECLARE_DEBUG_DRAWING(id, type) ((void) 0)
+#define COMPLEX_DRAWING(id, ...) ((void) 0)
+#define DOT(id, ...) ((void) 0)
+#define LINE(id, ...) ((void) 0)
+#define CIRCLE(id, ...) ((void) 0)
+#define RECTANGLE(id, ...) ((void) 0)
@@ -0,0 +1,11 @@
+/**
+ * @file DebugImages.h
+ * Stand-in for the framework's debug images, everything compiles to nothing.
+ * @author <a href="mailto:agent@local">agent</a>
+ */
+
+#pragma once
+
+#define DECLARE_DEBUG_IMAGE(id)
+#define INIT_DEBUG_IMAGE(id, image) ((void) 0)
+#define SEND_DEBUG_IMAGE(id) ((void) 0)
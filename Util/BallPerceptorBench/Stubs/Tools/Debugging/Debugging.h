@@ -0,0 +1,12 @@
+/**
+ * @file Debugging.h
+ * Stand-in for the framework's debug output, everything compiles to nothing.
+ * The text is still compiled, it is just never written.
+ * @author <a href="mailto:agent@local">agent</a>
+ */
+
+#pragma once
+
+#include <sstream>
+
+#define OUTPUT_TEXT(...) do { if (false) { std::ostringstream _stream; _stream << __VA_ARGS__; } } while (false)
@@ -0,0 +1,40 @@
+/**
+ * @file Stopwatch.h
+ * Stand-in for the framework's stopwatch. Instead of sending the measurements
+ * to the debugger, the times of each event are summed up per frame so that
+ * the bench driver can collect them after each update().
+ * @author <a href="mailto:agent@local">agent</a>
+ */
+
+#pragma once
+
+#include <chrono>
+#include <map>
+#include <string>
+
+class Stopwatch
+{
+public:
+  typedef std::map<std::string, unsigned long long> Times; //-- event -> nanoseconds
+
+  static unsigned long long getTime()
+  {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  static Times& frameTimes()
+  {
+    static Times times;
+    return times;
+  }
+
+  static void record(const char* eventID, unsigned long long time) { frameTimes()[eventID] += time; }
+};
+
+#define STOP_TIME_ON_REQUEST(eventID, ...) \
+  { \
+    const unsigned long long _stopwatchStart = Stopwatch::getTime(); \
+    __VA_ARGS__ \
+    Stopwatch::record(eventID, Stopwatch::getTime() - _stopwatchStart); \
+  }
@@ -0,0 +1,59 @@
+/**
+ * @file Geometry.h
+ * Stand-in for the framework's geometry helpers used by the ball perceptor.
+ * @author <a href="mailto:agent@local">agent</a>
+ */
+
+#pragma once
+
+#include "Representations/Perception/CameraMatrix.h"
+#include "Representations/Infrastructure/CameraInfo.h"
+
+class Geometry
+{
+public:
+  class Circle
+  {
+  public:
+    Vector2<> center;
+    float radius;
+    Circle() : radius(0) {}
+  };
+
+  static bool calculatePointOnField(const Vector2<>& image, const float& fieldCoord,
+                                    const CameraMatrix& cameraMatrix, const CameraInfo& cameraInfo,
+                                    Vector3<>& pointOnField)
+  {
+    const Vector3<> unscaledCamera(cameraInfo.focalLength,
+                                   cameraInfo.opticalCenter.x - image.x,
+                                   cameraInfo.opticalCenter.y - image.y);
+    const Vector3<> unscaledField = cameraMatrix.rotation * unscaledCamera;
+
+    if (fieldCoord > cameraMatrix.translation.z)
+    {
+      if (unscaledField.z <= 0)
+        return false;
+    }
+    else if (unscaledField.z >= 0)
+      return false;
+
+    const float scale = (cameraMatrix.translation.z - fieldCoord) / unscaledField.z;
+    pointOnField.x = cameraMatrix.translation.x - scale * unscaledField.x;
+    pointOnField.y = cameraMatrix.translation.y - scale * unscaledField.y;
+    pointOnField.z = fieldCoord;
+    return true;
+  }
+
+  static bool calculatePointInImage(const Vector3<>& pointInWorld, const CameraMatrix& cameraMatrix,
+                                    const CameraInfo& cameraInfo, Vector2<>& pointInImage)
+  {
+    const Vector3<> pointInCamera = cameraMatrix.rotation.invert() * (pointInWorld - cameraMatrix.translation);
+    if (pointInCamera.x <= 0)
+      return false;
+
+    const float scale = cameraInfo.focalLength / pointInCamera.x;
+    pointInImage.x = cameraInfo.opticalCenter.x - scale * pointInCamera.y;
+    pointInImage.y = cameraInfo.opticalCenter.y - scale * pointInCamera.z;
+    return true;
+  }
+};
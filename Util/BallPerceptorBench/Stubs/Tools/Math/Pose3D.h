@@ -0,0 +1,47 @@
+/**
+ * @file Pose3D.h
+ * Stand-in for the framework's rotation matrix and 3D pose.
+ * @author <a href="mailto:agent@local">agent</a>
+ */
+
+#pragma once
+
+#include "Tools/Math/Vector.h"
+
+class RotationMatrix
+{
+public:
+  Vector3<> c0, c1, c2; //-- columns
+
+  RotationMatrix() : c0(1, 0, 0), c1(0, 1, 0), c2(0, 0, 1) {}
+
+  Vector3<> operator*(const Vector3<>& v) const { return c0 * v.x + c1 * v.y + c2 * v.z; }
+
+  //-- The transposed matrix, as it is orthogonal
+  RotationMatrix invert() const
+  {
+    RotationMatrix inverse;
+    inverse.c0 = Vector3<>(c0.x, c1.x, c2.x);
+    inverse.c1 = Vector3<>(c0.y, c1.y, c2.y);
+    inverse.c2 = Vector3<>(c0.z, c1.z, c2.z);
+    return inverse;
+  }
+
+  //-- Positive angles tilt the x-axis downwards
+  RotationMatrix& rotateY(float angle)
+  {
+    const float c = std::cos(angle), s = std::sin(angle);
+    const Vector3<> n0 = c0 * c - c2 * s;
+    const Vector3<> n2 = c0 * s + c2 * c;
+    c0 = n0;
+    c2 = n2;
+    return *this;
+  }
+};
+
+class Pose3D
+{
+public:
+  RotationMatrix rotation;
+  Vector3<> translation;
+};
@@ -0,0 +1,73 @@
+/**
+ * @file Vector.h
+ * Stand-in for the framework's vector types, only what the ball perceptor uses.
+ * @author <a href="mailto:agent@local">agent</a>
+ */
+
+#pragma once
+
+#include <cmath>
+
+template <class V = float> class Vector2
+{
+public:
+  V x, y;
+
+  Vector2() : x(0), y(0) {}
+  Vector2(V x, V y) : x(x), y(y) {}
+
+  Vector2 operator+(const Vector2& o) const { return Vector2(x + o.x, y + o.y); }
+  Vector2 operator-(const Vector2& o) const { return Vector2(x - o.x, y - o.y); }
+  Vector2 operator*(V f) const { return Vector2(x * f, y * f); }
+  Vector2 operator/(V f) const { return Vector2(x / f, y / f); }
+  Vector2& operator+=(const Vector2& o) { x += o.x; y += o.y; return *this; }
+  bool operator==(const Vector2& o) const { return x == o.x && y == o.y; }
+  bool operator!=(const Vector2& o) const { return !(*this == o); }
+
+  V sqr() const { return x * x + y * y; }
+  V squareAbs() const { return sqr(); }
+  V abs() const { return (V) std::sqrt((float) sqr()); }
+};
+
+template <class V = float> class Vector3
+{
+public:
+  V x, y, z;
+
+  Vector3() : x(0), y(0), z(0) {}
+  Vector3(V x, V y, V z) : x(x), y(y), z(z) {}
+
+  Vector3 operator+(const Vector3& o) const { return Vector3(x + o.x, y + o.y, z + o.z); }
+  Vector3 operator-(const Vector3& o) const { return Vector3(x - o.x, y - o.y, z - o.z); }
+  Vector3 operator*(V f) const { return Vector3(x * f, y * f, z * f); }
+  Vector3 operator/(V f) const { return Vector3(x / f, y / f, z / f); }
+  V operator*(const Vector3& o) const { return x * o.x + y * o.y + z * o.z; } //-- Scalar product
+
+  V abs() const { return (V) std::sqrt((float)(x * x + y * y + z * z)); }
+  Vector3& normalize(V len)
+  {
+    const V l = abs();
+    if (l != 0)
+      *this = *this * (len / l);
+    return *this;
+  }
+};
+
+template <class V = float> class Vector4
+{
+public:
+  V v[4];
+
+  Vector4() { v[0] = v[1] = v[2] = v[3] = 0; }
+  Vector4(V a, V b, V c, V d) { v[0] = a; v[1] = b; v[2] = c; v[3] = d; }
+
+  V& operator[](int i) { return v[i]; }
+  const V& operator[](int i) const { return v[i]; }
+};
+
+typedef Vector2<int>   Vector2i;
+typedef Vector2<float> Vector2f;
+typedef Vector3<int>   Vector3i;
+typedef Vector3<float> Vector3f;
+typedef Vector4<int>   Vector4i;
+typedef Vector4<float> Vector4f;
@@ -0,0 +1,64 @@
+/**
+ * @file Module.h
+ * Stand-in for the framework's module macros. Every required representation
+ * is a single instance that the bench driver fills before calling update().
+ * Parameters come from moduleParameters(), which the bench driver fills
+ * before creating a module, instead of the configuration file of the module.
+ * @author <a href="mailto:agent@local">agent</a>
+ */
+
+#pragma once
+
+#include <map>
+#include <sstream>
+#include <string>
+
+template <class T> T& blackboardRepresentation()
+{
+  static T instance;
+  return instance;
+}
+
+//-- Values of the parameters by their names, the ones not set are zero or empty
+inline std::map<std::string, std::string>& moduleParameters()
+{
+  static std::map<std::string, std::string> parameters;
+  return parameters;
+}
+
+template <class T> T moduleParameter(const char* name)
+{
+  T value = T();
+  const std::map<std::string, std::string>::const_iterator i = moduleParameters().find(name);
+  if (i != moduleParameters().end())
+    std::istringstream(i->second) >> value;
+  return value;
+}
+
+template <> inline std::string moduleParameter<std::string>(const char* name)
+{
+  const std::map<std::string, std::string>::const_iterator i = moduleParameters().find(name);
+  return i != moduleParameters().end() ? i->second : std::string();
+}
+
+#define MODULE(name) \
+  class name##Base \
+  { \
+  public: \
+    virtual ~name##Base() {}
+
+#define REQUIRES(representation) \
+  protected: \
+    const representation& the##representation = blackboardRepresentation<representation>();
+
+#define PROVIDES_WITH_MODIFY_AND_OUTPUT_AND_DRAW(representation) \
+  public: \
+    virtual void update(representation& the##representation) = 0;
+
+#define LOADS_PARAMETER(type, name) \
+  protected: \
+    type name = moduleParameter<type>(#name);
+
+#define END_MODULE };
+
+#define MAKE_MODULE(name, category)
@@ -0,0 +1,30 @@
+/**
+ * @file RingBuffer.h
+ * Stand-in for the framework's fixed-size ring buffer.
+ * @author <a href="mailto:agent@local">agent</a>
+ */
+
+#pragma once
+
+template <class V, int n> class RingBuffer
+{
+public:
+  RingBuffer() : current(n - 1), numberOfEntries(0) {}
+
+  void add(const V& v)
+  {
+    current = (current + 1) % n;
+    buffer[current] = v;
+    if (numberOfEntries < n)
+      ++numberOfEntries;
+  }
+
+  const V& operator[](int i) const { return buffer[(current - i + n) % n]; }
+  int size() const { return numberOfEntries; }
+  int capacity() const { return n; }
+
+private:
+  int current;
+  int numberOfEntries;
+  V buffer[n];
+};